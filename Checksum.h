@@ -0,0 +1,37 @@
+// Checksum.h
+
+// The 64-bit checksum the binary map and hierarchy files are verified with.
+// Start from CHECKSUM_SEED and add the bytes in the order they are written;
+// a run of bytes whose length isn't a multiple of 8 is checksummed as if zero
+// padded to one.  Not cryptographic: it catches truncation and corruption.
+
+#ifndef CHECKSUM_INCLUDED
+#define CHECKSUM_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+const std::uint64_t CHECKSUM_SEED = 0xCBF29CE484222325ULL;
+
+// Word at a time, so that verifying a large file costs about as much as reading it
+inline std::uint64_t addToChecksum(std::uint64_t h, const char* p, std::size_t n)
+{
+    for (; n >= 8; p += 8, n -= 8)
+    {
+        std::uint64_t word;
+        std::memcpy(&word, p, 8);
+        h = (h ^ word) * 0x9E3779B97F4A7C15ULL;
+        h ^= h >> 29;
+    }
+    if (n != 0)   // zero padding completes the last word
+    {
+        std::uint64_t word = 0;
+        std::memcpy(&word, p, n);
+        h = (h ^ word) * 0x9E3779B97F4A7C15ULL;
+        h ^= h >> 29;
+    }
+    return h;
+}
+
+#endif // CHECKSUM_INCLUDED
@@ -0,0 +1,657 @@
+#include "provided.h"
+#include "RouterWorkspace.h"
+#include "Checksum.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <queue>
+#include <utility>
+#include <vector>
+using namespace std;
+
+//Preprocesses a StreetMap into a contraction hierarchy and answers shortest route queries with it.
+//Nodes are contracted one at a time, least important first: contracting a node removes it from the
+//remaining graph and adds a shortcut between two of its neighbours whenever the route through it was
+//their only shortest connection.  A query then only ever moves towards more important nodes, from both
+//ends, and the two searches meet at the most important node of the route.  The map stores every segment
+//in both directions with the same length, so one upward graph serves both searches.
+
+class ContractionHierarchyImpl
+{
+public:
+    ContractionHierarchyImpl();
+    ~ContractionHierarchyImpl();
+    bool build(const StreetMap* sm);
+    bool save(string hierarchyFile) const;
+    bool load(string hierarchyFile, const StreetMap* sm);
+    bool matches(const StreetMap* sm) const;
+    size_t shortcutCount() const;
+    bool findRoute(NodeId start, NodeId end, vector<EdgeId>& edges, double& distance, RouteSearchStats* stats, RouterWorkspace* workspace) const;
+
+private:
+    struct HierarchyEdge   //a map segment or a shortcut between nodes a and b, usable in either direction
+    {
+        NodeId a;
+        NodeId b;
+        double length;
+        NodeId middle;       //NO_NODE for a map segment, otherwise the node the shortcut bypasses
+        uint32_t toA;        //map segment: EdgeId from a to b; shortcut: hierarchy edge between a and middle
+        uint32_t toB;        //shortcut: hierarchy edge between middle and b
+    };
+
+    struct QueueEntry
+    {
+        QueueEntry(double d, NodeId n)
+            : distance(d), node(n)
+        {}
+        bool operator>(const QueueEntry& other) const { return distance > other.distance; }
+
+        double distance;
+        NodeId node;
+    };
+
+    typedef priority_queue<QueueEntry, vector<QueueEntry>, greater<QueueEntry>> Queue;
+
+    //state used only while building
+    struct Contraction
+    {
+        vector<vector<pair<NodeId, uint32_t>>> neighbours;   //remaining graph: (neighbour, hierarchy edge)
+        vector<bool> contracted;
+        vector<int> contractedNeighbours;
+        vector<double> witnessDistance;                      //all infinity between witness searches
+        vector<NodeId> touched;
+    };
+
+    static const int WITNESS_SETTLE_LIMIT = 100;   //a witness search that gives up early only costs an extra shortcut
+
+    void clear();
+    uint64_t fingerprint(const StreetGraph& g) const;
+    bool isConsistent(const StreetGraph& g) const;
+    int contract(Contraction& c, NodeId v, bool simulateOnly);
+    void witnessSearch(Contraction& c, NodeId from, NodeId excluded, double limit) const;
+    void connect(Contraction& c, NodeId u, NodeId w, uint32_t edge) const;
+    void unpack(vector<pair<uint32_t, NodeId>>& pending, vector<EdgeId>& edges) const;
+    EdgeId mapEdge(const HierarchyEdge& he, NodeId from) const;
+
+    const StreetMap* m_streetMap;
+    uint32_t m_nodeCount;
+    uint32_t m_mapEdgeCount;
+    uint64_t m_fingerprint;
+    uint64_t m_mapGeneration;   //of the map when built or loaded; any reload of the map changes it
+    vector<HierarchyEdge> m_edges;
+    //upward graph in compressed sparse row form: the edges from each node to more important neighbours
+    vector<uint32_t> m_upFirst;
+    vector<NodeId> m_upTarget;
+    vector<double> m_upLength;
+    vector<uint32_t> m_upEdge;
+};
+
+ContractionHierarchyImpl::ContractionHierarchyImpl()
+{
+    clear();
+}
+
+ContractionHierarchyImpl::~ContractionHierarchyImpl()
+{
+}
+
+void ContractionHierarchyImpl::clear()
+{
+    m_streetMap = nullptr;
+    m_nodeCount = 0;
+    m_mapEdgeCount = 0;
+    m_fingerprint = 0;
+    m_mapGeneration = 0;
+    m_edges.clear();
+    m_upFirst.assign(1, 0);
+    m_upTarget.clear();
+    m_upLength.clear();
+    m_upEdge.clear();
+}
+
+uint64_t ContractionHierarchyImpl::fingerprint(const StreetGraph& g) const
+{
+    //identifies the exact graph a saved hierarchy belongs to
+    uint64_t h = 0xCBF29CE484222325ULL;
+    for (uint32_t i = 0; i != g.edgeCount; i++)
+    {
+        uint64_t length;
+        memcpy(&length, &g.edgeLengths[i], sizeof(length));
+        h = (h ^ g.edgeTargets[i] ^ (length << 1)) * 0x9E3779B97F4A7C15ULL;
+        h ^= h >> 29;
+    }
+    for (uint32_t i = 0; i <= g.nodeCount; i++)
+    {
+        h = (h ^ g.firstEdge[i]) * 0x9E3779B97F4A7C15ULL;
+        h ^= h >> 29;
+    }
+    return h;
+}
+
+bool ContractionHierarchyImpl::build(const StreetMap* sm)
+{
+    clear();
+    const StreetGraph& g = sm->graph();
+    const double infinity = numeric_limits<double>::infinity();
+
+    Contraction c;
+    c.neighbours.resize(g.nodeCount);
+    c.contracted.assign(g.nodeCount, false);
+    c.contractedNeighbours.assign(g.nodeCount, 0);
+    c.witnessDistance.assign(g.nodeCount, infinity);
+
+    //one hierarchy edge per pair of connected nodes, the shortest segment between them
+    for (NodeId u = 0; u != g.nodeCount; u++)
+    {
+        for (EdgeId e : g.edgesFrom(u))
+        {
+            NodeId v = g.edgeTargets[e];
+            if (v <= u)   //each pair is seen from both ends; take it from the lower id, and skip loops
+                continue;
+            HierarchyEdge he = { u, v, g.edgeLengths[e], NO_NODE, e, 0 };
+            m_edges.push_back(he);
+            connect(c, u, v, (uint32_t)m_edges.size() - 1);
+        }
+    }
+
+    //contract in order of priority (shortcuts added - edges removed + neighbours already contracted), updating
+    //priorities lazily: a node whose priority has grown since it was queued goes back into the queue
+    priority_queue<pair<int, NodeId>, vector<pair<int, NodeId>>, greater<pair<int, NodeId>>> order;
+    for (NodeId v = 0; v != g.nodeCount; v++)
+        order.push(make_pair(contract(c, v, true), v));
+
+    vector<vector<uint32_t>> upward(g.nodeCount);
+    while (!order.empty())
+    {
+        NodeId v = order.top().second;
+        order.pop();
+        int priority = contract(c, v, true) + c.contractedNeighbours[v];
+        if (!order.empty() && priority > order.top().first)
+        {
+            order.push(make_pair(priority, v));
+            continue;
+        }
+
+        //every neighbour still in the graph is more important than v
+        for (size_t i = 0; i != c.neighbours[v].size(); i++)
+            upward[v].push_back(c.neighbours[v][i].second);
+        contract(c, v, false);
+    }
+
+    m_upFirst.assign(g.nodeCount + 1, 0);
+    for (NodeId v = 0; v != g.nodeCount; v++)
+    {
+        m_upFirst[v + 1] = m_upFirst[v] + (uint32_t)upward[v].size();
+        for (size_t i = 0; i != upward[v].size(); i++)
+        {
+            const HierarchyEdge& he = m_edges[upward[v][i]];
+            m_upTarget.push_back(he.a == v ? he.b : he.a);
+            m_upLength.push_back(he.length);
+            m_upEdge.push_back(upward[v][i]);
+        }
+    }
+
+    m_streetMap = sm;
+    m_nodeCount = g.nodeCount;
+    m_mapEdgeCount = g.edgeCount;
+    m_fingerprint = fingerprint(g);
+    m_mapGeneration = sm->generation();
+    return true;
+}
+
+void ContractionHierarchyImpl::connect(Contraction& c, NodeId u, NodeId w, uint32_t edge) const
+{
+    //keeps at most one edge between two remaining nodes, the shorter one
+    for (int side = 0; side != 2; side++)
+    {
+        vector<pair<NodeId, uint32_t>>& list = c.neighbours[side == 0 ? u : w];
+        NodeId other = (side == 0 ? w : u);
+        bool found = false;
+        for (size_t i = 0; i != list.size() && !found; i++)
+        {
+            if (list[i].first == other)
+            {
+                found = true;
+                if (m_edges[edge].length < m_edges[list[i].second].length)
+                    list[i].second = edge;
+            }
+        }
+        if (!found)
+            list.push_back(make_pair(other, edge));
+    }
+}
+
+int ContractionHierarchyImpl::contract(Contraction& c, NodeId v, bool simulateOnly)
+{
+    //returns how many shortcuts contracting v adds minus how many edges it removes
+    vector<pair<NodeId, uint32_t>> around = c.neighbours[v];
+    int shortcuts = 0;
+    for (size_t i = 0; i != around.size(); i++)
+    {
+        NodeId u = around[i].first;
+        double viaV = m_edges[around[i].second].length;
+        double longest = 0;
+        for (size_t j = i + 1; j != around.size(); j++)
+            longest = max(longest, viaV + m_edges[around[j].second].length);
+        if (longest == 0)
+            continue;
+
+        witnessSearch(c, u, v, longest);
+        for (size_t j = i + 1; j != around.size(); j++)
+        {
+            NodeId w = around[j].first;
+            double through = viaV + m_edges[around[j].second].length;
+            if (c.witnessDistance[w] <= through)   //another route is at least as short, no shortcut needed
+                continue;
+            shortcuts++;
+            if (!simulateOnly)
+            {
+                HierarchyEdge he = { u, w, through, v, around[i].second, around[j].second };
+                m_edges.push_back(he);
+            }
+        }
+        for (size_t t = 0; t != c.touched.size(); t++)
+            c.witnessDistance[c.touched[t]] = numeric_limits<double>::infinity();
+        c.touched.clear();
+
+        if (!simulateOnly)   //connect now, so later witness searches for v's other neighbours can use the shortcuts
+        {
+            for (uint32_t e = (uint32_t)m_edges.size() - 1; e < m_edges.size() && m_edges[e].middle == v && m_edges[e].a == u; e--)
+                connect(c, u, m_edges[e].b, e);
+        }
+    }
+
+    if (!simulateOnly)
+    {
+        c.contracted[v] = true;
+        for (size_t i = 0; i != around.size(); i++)
+        {
+            vector<pair<NodeId, uint32_t>>& list = c.neighbours[around[i].first];
+            for (size_t k = 0; k != list.size(); k++)
+            {
+                if (list[k].first == v)
+                {
+                    list[k] = list.back();
+                    list.pop_back();
+                    break;
+                }
+            }
+            c.contractedNeighbours[around[i].first]++;
+        }
+        c.neighbours[v].clear();
+        c.neighbours[v].shrink_to_fit();
+    }
+    return shortcuts - (int)around.size();
+}
+
+void ContractionHierarchyImpl::witnessSearch(Contraction& c, NodeId from, NodeId excluded, double limit) const
+{
+    //Dijkstra from 'from' through the remaining graph without 'excluded', stopping at 'limit' miles or after
+    //WITNESS_SETTLE_LIMIT nodes; leaves distances in c.witnessDistance for the nodes listed in c.touched
+    Queue open;
+    c.witnessDistance[from] = 0;
+    c.touched.push_back(from);
+    open.push(QueueEntry(0, from));
+    int settled = 0;
+    while (!open.empty() && settled < WITNESS_SETTLE_LIMIT)
+    {
+        QueueEntry cur = open.top();
+        open.pop();
+        if (cur.distance > c.witnessDistance[cur.node])
+            continue;
+        if (cur.distance > limit)
+            break;
+        settled++;
+        const vector<pair<NodeId, uint32_t>>& list = c.neighbours[cur.node];
+        for (size_t i = 0; i != list.size(); i++)
+        {
+            NodeId next = list[i].first;
+            if (next == excluded)
+                continue;
+            double d = cur.distance + m_edges[list[i].second].length;
+            if (d < c.witnessDistance[next])
+            {
+                if (c.witnessDistance[next] == numeric_limits<double>::infinity())
+                    c.touched.push_back(next);
+                c.witnessDistance[next] = d;
+                open.push(QueueEntry(d, next));
+            }
+        }
+    }
+}
+
+bool ContractionHierarchyImpl::findRoute(NodeId start, NodeId end, vector<EdgeId>& edges, double& distance, RouteSearchStats* stats, RouterWorkspace* workspace) const
+{
+    //side 0 searches up from start and side 1 up from end; a label's previous edge is a hierarchy edge
+    thread_local RouterWorkspace threadWorkspace;   //used when the caller doesn't supply one
+    RouterWorkspace& ws = (workspace != nullptr ? *workspace : threadWorkspace);
+    chrono::steady_clock::time_point began = chrono::steady_clock::now();
+    size_t allocationsBefore = ws.allocations();
+    size_t edgesCapacity = edges.capacity();
+    RouteSearchStats work;
+    ws.beginSearch(m_nodeCount);
+    SearchHeap* open[2] = { &ws.queue(0), &ws.queue(1) };
+    const NodeId origin[2] = { start, end };
+    for (int side = 0; side != 2; side++)
+    {
+        ws.setLabel(side, origin[side], 0, NO_NODE, NO_EDGE);
+        open[side]->push(SearchEntry(0, 0, origin[side]));
+    }
+    work.heapPushes = work.peakFrontier = 2;
+
+    //both searches only go upwards; each stops once nothing left in its queue can improve the best meeting
+    double best = numeric_limits<double>::infinity();
+    NodeId meeting = NO_NODE;
+    for (;;)
+    {
+        for (int side = 0; side != 2; side++)
+        {
+            if (!open[side]->empty() && open[side]->top().distanceSoFar >= best)
+                open[side]->clear();
+        }
+        if (open[0]->empty() && open[1]->empty())
+            break;
+        int side = (open[1]->empty() || (!open[0]->empty() && open[0]->top().distanceSoFar <= open[1]->top().distanceSoFar)) ? 0 : 1;
+
+        SearchEntry cur = open[side]->top();
+        open[side]->pop();
+        if (cur.distanceSoFar > ws.distance(side, cur.node))
+            continue;
+        work.nodesSettled++;
+        double through = cur.distanceSoFar + ws.distance(1 - side, cur.node);
+        if (through < best)
+        {
+            best = through;
+            meeting = cur.node;
+        }
+        for (uint32_t i = m_upFirst[cur.node]; i != m_upFirst[cur.node + 1]; i++)
+        {
+            work.edgesRelaxed++;
+            NodeId next = m_upTarget[i];
+            double d = cur.distanceSoFar + m_upLength[i];
+            if (d < ws.distance(side, next))
+            {
+                ws.setLabel(side, next, d, cur.node, m_upEdge[i]);
+                open[side]->push(SearchEntry(d, d, next));
+                work.heapPushes++;
+            }
+        }
+        work.peakFrontier = max(work.peakFrontier, open[0]->size() + open[1]->size());
+    }
+    if (meeting != NO_NODE)
+    {
+        //one stack of (hierarchy edge, node it is walked from) with the next edge of the route on top: meeting -> end
+        //goes in first, reversed, then start -> meeting, which walking the forward parents already gives reversed
+        vector<pair<uint32_t, NodeId>>& pending = ws.unpackStack();
+        pending.clear();
+        for (NodeId n = meeting; n != end; n = ws.previousNode(1, n))
+            pending.push_back(make_pair(ws.previousEdge(1, n), n));
+        reverse(pending.begin(), pending.end());
+        for (NodeId n = meeting; n != start; n = ws.previousNode(0, n))
+            pending.push_back(make_pair(ws.previousEdge(0, n), ws.previousNode(0, n)));
+
+        edges.clear();
+        unpack(pending, edges);
+        distance = best;
+    }
+    if (stats != nullptr)
+    {
+        work.allocations = ws.allocations() - allocationsBefore + (edges.capacity() != edgesCapacity ? 1 : 0);
+        work.seconds = chrono::duration<double>(chrono::steady_clock::now() - began).count();
+        *stats = work;
+    }
+    return meeting != NO_NODE;
+}
+
+void ContractionHierarchyImpl::unpack(vector<pair<uint32_t, NodeId>>& pending, vector<EdgeId>& edges) const
+{
+    //expands the hierarchy edges on the stack into the map segments they stand for, in travel order
+    while (!pending.empty())
+    {
+        uint32_t e = pending.back().first;
+        NodeId f = pending.back().second;
+        pending.pop_back();
+        const HierarchyEdge& he = m_edges[e];
+        if (he.middle == NO_NODE)
+        {
+            edges.push_back(mapEdge(he, f));
+            continue;
+        }
+        uint32_t first = (he.a == f ? he.toA : he.toB);
+        uint32_t second = (he.a == f ? he.toB : he.toA);
+        pending.push_back(make_pair(second, he.middle));   //last in, first out: 'first' is expanded next
+        pending.push_back(make_pair(first, f));
+    }
+}
+
+EdgeId ContractionHierarchyImpl::mapEdge(const HierarchyEdge& he, NodeId from) const
+{
+    if (he.a == from)
+        return he.toA;
+    //walked backwards: the map stores the same segment from b to a as well, with the same length
+    const StreetGraph& g = m_streetMap->graph();
+    EdgeId best = he.toA;
+    for (EdgeId e : g.edgesFrom(from))
+    {
+        if (g.edgeTargets[e] == he.a && (best == he.toA || g.edgeLengths[e] < g.edgeLengths[best]))
+            best = e;
+    }
+    return best;
+}
+
+bool ContractionHierarchyImpl::isConsistent(const StreetGraph& g) const
+{
+    //one pass over what was read, so that no id in it can send a query outside an array or into an endless unpack
+    for (uint32_t e = 0; e != m_edges.size(); e++)
+    {
+        const HierarchyEdge& he = m_edges[e];
+        if (he.a >= g.nodeCount || he.b >= g.nodeCount)
+            return false;
+        if (he.middle == NO_NODE)   //a map segment: toA must be an edge from a to b
+        {
+            if (he.toA < g.firstEdge[he.a] || he.toA >= g.firstEdge[he.a + 1] || g.edgeTargets[he.toA] != he.b)
+                return false;
+        }
+        else if (he.middle >= g.nodeCount || he.toA >= e || he.toB >= e)   //a shortcut is built from edges made before it
+            return false;
+    }
+    if (m_upFirst[0] != 0)
+        return false;
+    for (NodeId n = 0; n != g.nodeCount; n++)
+    {
+        if (m_upFirst[n + 1] < m_upFirst[n])
+            return false;
+    }
+    for (size_t i = 0; i != m_upTarget.size(); i++)
+    {
+        if (m_upTarget[i] >= g.nodeCount || m_upEdge[i] >= m_edges.size())
+            return false;
+    }
+    return m_upFirst.back() == m_upTarget.size();
+}
+
+bool ContractionHierarchyImpl::matches(const StreetMap* sm) const
+{
+    //the same StreetMap object reloaded, even with a map of the same size, has a new generation
+    return sm == m_streetMap && sm != nullptr && sm->generation() == m_mapGeneration;
+}
+
+size_t ContractionHierarchyImpl::shortcutCount() const
+{
+    size_t count = 0;
+    for (size_t i = 0; i != m_edges.size(); i++)
+        count += (m_edges[i].middle != NO_NODE);
+    return count;
+}
+
+namespace
+{
+    const char HIERARCHY_FILE_MAGIC[8] = { 'D', 'N', 'C', 'H', 'I', 'E', 'R', '\0' };
+    const uint32_t HIERARCHY_FILE_VERSION = 2;
+
+    struct HierarchyFileHeader
+    {
+        char     magic[8];
+        uint32_t version;
+        uint32_t nodeCount;
+        uint32_t mapEdgeCount;
+        uint32_t edgeCount;
+        uint32_t upEdgeCount;
+        uint32_t padding;
+        uint64_t fingerprint;   //of the map graph the hierarchy was built from
+        uint64_t checksum;      //of the arrays after the header, each checksummed as it is written
+    };
+
+    template<typename T>
+    void writeArray(ofstream& outf, const vector<T>& v, uint64_t& checksum)
+    {
+        const char* bytes = reinterpret_cast<const char*>(v.data());
+        outf.write(bytes, sizeof(T) * v.size());
+        checksum = addToChecksum(checksum, bytes, sizeof(T) * v.size());
+    }
+
+    template<typename T>
+    bool readArray(ifstream& inf, vector<T>& v, size_t count, uint64_t& checksum)
+    {
+        v.resize(count);
+        char* bytes = reinterpret_cast<char*>(v.data());
+        if (!inf.read(bytes, sizeof(T) * count))
+            return false;
+        checksum = addToChecksum(checksum, bytes, sizeof(T) * count);
+        return true;
+    }
+}
+
+bool ContractionHierarchyImpl::save(string hierarchyFile) const
+{
+    ofstream outf(hierarchyFile, ios::binary | ios::trunc);
+    if (!outf)
+    {
+        cerr << "Cannot create hierarchy file!" << endl;
+        return false;
+    }
+    HierarchyFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, HIERARCHY_FILE_MAGIC, sizeof(header.magic));
+    header.version = HIERARCHY_FILE_VERSION;
+    header.nodeCount = m_nodeCount;
+    header.mapEdgeCount = m_mapEdgeCount;
+    header.edgeCount = (uint32_t)m_edges.size();
+    header.upEdgeCount = (uint32_t)m_upTarget.size();
+    header.fingerprint = m_fingerprint;
+
+    //copied field by field into zeroed records, so the padding HierarchyEdge has is written as zeros, not as
+    //whatever the memory held
+    vector<HierarchyEdge> records(m_edges.size());
+    if (!records.empty())
+        memset(static_cast<void*>(records.data()), 0, sizeof(HierarchyEdge) * records.size());
+    for (size_t i = 0; i != m_edges.size(); i++)
+    {
+        records[i].a = m_edges[i].a;
+        records[i].b = m_edges[i].b;
+        records[i].length = m_edges[i].length;
+        records[i].middle = m_edges[i].middle;
+        records[i].toA = m_edges[i].toA;
+        records[i].toB = m_edges[i].toB;
+    }
+
+    //the header goes in last, once the checksum of what follows it is known
+    outf.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    uint64_t checksum = CHECKSUM_SEED;
+    writeArray(outf, records, checksum);
+    writeArray(outf, m_upFirst, checksum);
+    writeArray(outf, m_upTarget, checksum);
+    writeArray(outf, m_upLength, checksum);
+    writeArray(outf, m_upEdge, checksum);
+    header.checksum = checksum;
+    outf.seekp(0);
+    outf.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    return (bool)outf.flush();
+}
+
+bool ContractionHierarchyImpl::load(string hierarchyFile, const StreetMap* sm)
+{
+    clear();
+    ifstream inf(hierarchyFile, ios::binary);
+    if (!inf)
+    {
+        cerr << "Cannot open hierarchy file!" << endl;
+        return false;
+    }
+    HierarchyFileHeader header;
+    if (!inf.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        memcmp(header.magic, HIERARCHY_FILE_MAGIC, sizeof(header.magic)) != 0 || header.version != HIERARCHY_FILE_VERSION)
+    {
+        cerr << "Not a hierarchy file, or written by an incompatible version!" << endl;
+        return false;
+    }
+    const StreetGraph& g = sm->graph();
+    if (header.nodeCount != g.nodeCount || header.mapEdgeCount != g.edgeCount || header.fingerprint != fingerprint(g))
+    {
+        cerr << "Hierarchy file was built for a different map!" << endl;
+        return false;
+    }
+    uint64_t checksum = CHECKSUM_SEED;
+    bool valid = readArray(inf, m_edges, header.edgeCount, checksum) && readArray(inf, m_upFirst, (size_t)header.nodeCount + 1, checksum) &&
+                 readArray(inf, m_upTarget, header.upEdgeCount, checksum) && readArray(inf, m_upLength, header.upEdgeCount, checksum) &&
+                 readArray(inf, m_upEdge, header.upEdgeCount, checksum) && inf.peek() == char_traits<char>::eof() &&
+                 checksum == header.checksum && isConsistent(g);
+    if (!valid)
+    {
+        cerr << "Hierarchy file is truncated or corrupt!" << endl;
+        clear();
+        return false;
+    }
+    m_streetMap = sm;
+    m_nodeCount = header.nodeCount;
+    m_mapEdgeCount = header.mapEdgeCount;
+    m_fingerprint = header.fingerprint;
+    m_mapGeneration = sm->generation();
+    return true;
+}
+
+//******************** ContractionHierarchy functions *************************
+
+ContractionHierarchy::ContractionHierarchy()
+{
+    m_impl = new ContractionHierarchyImpl;
+}
+
+ContractionHierarchy::~ContractionHierarchy()
+{
+    delete m_impl;
+}
+
+bool ContractionHierarchy::build(const StreetMap* sm)
+{
+    return m_impl->build(sm);
+}
+
+bool ContractionHierarchy::save(string hierarchyFile) const
+{
+    return m_impl->save(hierarchyFile);
+}
+
+bool ContractionHierarchy::load(string hierarchyFile, const StreetMap* sm)
+{
+    return m_impl->load(hierarchyFile, sm);
+}
+
+bool ContractionHierarchy::matches(const StreetMap* sm) const
+{
+    return m_impl->matches(sm);
+}
+
+size_t ContractionHierarchy::shortcutCount() const
+{
+    return m_impl->shortcutCount();
+}
+
+bool ContractionHierarchy::findRoute(NodeId start, NodeId end, vector<EdgeId>& edges, double& distance, RouteSearchStats* stats, RouterWorkspace* workspace) const
+{
+    return m_impl->findRoute(start, end, edges, distance, stats, workspace);
+}
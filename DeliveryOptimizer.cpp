@@ -1,8 +1,16 @@
 #include "provided.h"
+#include "ThreadPool.h"
 #include <vector>
+#include <chrono>
+#include <limits>
+#include <algorithm>
+#include <utility>
 using namespace std;
 
-//**IN PROGRESS** Optimizes delivery route 
+//Reorders deliveries to shorten the round trip from the depot: a nearest neighbour tour, improved with 2-opt and
+//Or-opt moves until no move helps or the time budget runs out.
+//For a fleet, deliveries are first shared out among the drivers' routes, which are then improved by moving stops
+//between routes (relocating one, or exchanging two) and re-ordering each changed route as above
 
 class DeliveryOptimizerImpl
 {
@@ -14,21 +22,68 @@ public:
         vector<DeliveryRequest>& deliveries,
         double& oldCrowDistance,
         double& newCrowDistance) const;
+    void optimizeDeliveryOrder(
+        vector<DeliveryRequest>& deliveries,
+        const DistanceMatrix& roadDistances,
+        vector<size_t>& stopOrder,
+        double& oldDistance,
+        double& newDistance) const;
+    void assignDeliveries(
+        const DistanceMatrix& roadDistances,
+        int drivers,
+        double timeBudget,
+        vector<vector<size_t>>& tours,
+        vector<double>& tourDistances) const;
+    void setTimeBudget(double seconds);
 
 private:
+    //a fleet route is one driver's stops in visiting order, without the depot the driver leaves from and returns to
+    struct FleetMove
+    {
+        double delta;    //change in total distance; negative if the move helps
+        bool exchange;   //swap stop i of route a with stop j of route b; otherwise move stop i of route a to before position j of route b
+        int a, b, i, j;
+    };
+
+    static chrono::steady_clock::time_point deadlineAfter(double seconds);
+    bool roadCost(const DistanceMatrix& roadDistances, vector<double>& cost) const;
+
+    //a tour is the stops in visiting order with the depot (stop 0) first; it returns to the depot after the last stop.
+    //cost is the stop-to-stop distance matrix, row major.  Moves assume it is symmetric, so a reversed stretch of
+    //the tour costs the same as it did forwards
+    void optimizeTour(const vector<double>& cost, int stops, vector<int>& tour, double& oldDistance, double& newDistance,
+        chrono::steady_clock::time_point deadline) const;
+    void reorder(vector<DeliveryRequest>& deliveries, const vector<int>& tour) const;
+    double tourCost(const vector<int>& tour, const vector<double>& cost, int stops) const;
+    void nearestNeighbourTour(vector<int>& tour, const vector<double>& cost, int stops) const;
+    void improveTour(vector<int>& tour, const vector<double>& cost, int stops, chrono::steady_clock::time_point deadline) const;
+    bool improveTwoOpt(vector<int>& tour, const vector<double>& cost, int stops, chrono::steady_clock::time_point deadline) const;
+    bool improveOrOpt(vector<int>& tour, const vector<double>& cost, int stops, chrono::steady_clock::time_point deadline) const;
+
+    void initialFleetRoutes(const vector<double>& cost, int stops, int drivers, size_t capacity, vector<vector<int>>& routes) const;
+    FleetMove bestMoveBetween(const vector<vector<int>>& routes, int a, int b, const vector<double>& cost, int stops, size_t capacity,
+        chrono::steady_clock::time_point deadline) const;
+    void optimizeFleetRoute(vector<int>& route, const vector<double>& cost, int stops, chrono::steady_clock::time_point deadline) const;
+    double routeCost(const vector<int>& route, const vector<double>& cost, int stops) const;
+
+    static const int MAX_OR_OPT_LENGTH = 3;   //longest run of stops an Or-opt move relocates
+
     const StreetMap* m_streetMap;
-    PointToPointRouter* m_router;
+    double m_timeBudget;   //seconds optimizeDeliveryOrder may spend improving a tour
 };
 
 DeliveryOptimizerImpl::DeliveryOptimizerImpl(const StreetMap* sm)
-    :m_streetMap(sm)
+    :m_streetMap(sm), m_timeBudget(1.0)
 {
-    m_router = new PointToPointRouter(m_streetMap);
 }
 
 DeliveryOptimizerImpl::~DeliveryOptimizerImpl()
 {
-    delete m_router;
+}
+
+void DeliveryOptimizerImpl::setTimeBudget(double seconds)
+{
+    m_timeBudget = seconds;
 }
 
 void DeliveryOptimizerImpl::optimizeDeliveryOrder(   //DeliveryRequest contains a string for the name of the item and a GeoCoord location for the location to deliver
@@ -37,18 +92,421 @@ void DeliveryOptimizerImpl::optimizeDeliveryOrder(   //DeliveryRequest contains
     double& oldCrowDistance,
     double& newCrowDistance) const
 {
-    oldCrowDistance = 0;
-    GeoCoord startLocation = depot;
+    int stops = (int)deliveries.size() + 1;
+    vector<double> cost((size_t)stops * stops);
+    for (int i = 0; i != stops; i++)
+    {
+        const GeoCoord& from = (i == 0 ? depot : deliveries[i - 1].location);
+        for (int j = 0; j != stops; j++)
+            cost[(size_t)i * stops + j] = distanceEarthMiles(from, (j == 0 ? depot : deliveries[j - 1].location));
+    }
+
+    vector<int> tour;
+    optimizeTour(cost, stops, tour, oldCrowDistance, newCrowDistance, deadlineAfter(m_timeBudget));
+    reorder(deliveries, tour);
+}
+
+void DeliveryOptimizerImpl::optimizeDeliveryOrder(
+    vector<DeliveryRequest>& deliveries,
+    const DistanceMatrix& roadDistances,
+    vector<size_t>& stopOrder,
+    double& oldDistance,
+    double& newDistance) const
+{
+    int stops = (int)deliveries.size() + 1;
+    vector<double> cost;
+    bool connected = roadCost(roadDistances, cost);
+
+    vector<int> tour(stops);
+    for (int i = 0; i != stops; i++)
+        tour[i] = i;
+    if (connected)   //an unreachable stop makes every order infinitely long
+        optimizeTour(cost, stops, tour, oldDistance, newDistance, deadlineAfter(m_timeBudget));
+    else
+        oldDistance = newDistance = numeric_limits<double>::infinity();
+    reorder(deliveries, tour);
+    stopOrder.assign(tour.begin() + 1, tour.end());
+}
+
+void DeliveryOptimizerImpl::assignDeliveries(
+    const DistanceMatrix& roadDistances,
+    int drivers,
+    double timeBudget,
+    vector<vector<size_t>>& tours,
+    vector<double>& tourDistances) const
+{
+    chrono::steady_clock::time_point deadline = deadlineAfter(timeBudget);
+    int stops = (int)roadDistances.size();
+    drivers = max(drivers, 1);
+    size_t capacity = (stops - 1 + drivers - 1) / drivers;   //share the stops out evenly, or one driver would do everything
+    vector<double> cost;
+    bool connected = roadCost(roadDistances, cost);
 
-    for (vector<DeliveryRequest>::iterator it = deliveries.begin(); it != deliveries.end(); it++)
+    vector<vector<int>> routes(drivers);
+    if (connected)
+        initialFleetRoutes(cost, stops, drivers, capacity, routes);
+    else   //nothing to optimize when some stop can't be reached
     {
-        GeoCoord deliveryLocation = (*it).location;  //get location to deliver
-        double distance = distanceEarthMiles(startLocation, deliveryLocation);   //distance from starting location to delivery
-        startLocation = deliveryLocation; //update starting location
-        oldCrowDistance += distance;
+        for (int s = 1; s < stops; s++)
+            routes[(s - 1) % drivers].push_back(s);
+    }
+
+    vector<pair<int, int>> routePairs;
+    for (int a = 0; a != drivers; a++)
+    {
+        for (int b = a + 1; b != drivers; b++)
+            routePairs.push_back(make_pair(a, b));
+    }
+
+    //each round re-orders the routes the last round changed, then finds the best move between every pair of routes
+    //and makes the best of those that touch routes no other chosen move touches.  Both halves run on the thread pool
+    const double EPSILON = 1e-12;
+    ThreadPool& pool = ThreadPool::shared();
+    vector<bool> changed(drivers, true);
+    while (connected)
+    {
+        pool.parallelFor(drivers, [&](size_t r) {
+            if (changed[r])
+                optimizeFleetRoute(routes[r], cost, stops, deadline);
+        });
+        if (chrono::steady_clock::now() >= deadline)
+            break;
+
+        vector<FleetMove> moves(routePairs.size());
+        pool.parallelFor(routePairs.size(), [&](size_t p) {
+            moves[p] = bestMoveBetween(routes, routePairs[p].first, routePairs[p].second, cost, stops, capacity, deadline);
+        });
+        sort(moves.begin(), moves.end(), [](const FleetMove& x, const FleetMove& y) { return x.delta < y.delta; });
+
+        changed.assign(drivers, false);
+        bool improved = false;
+        for (const FleetMove& move : moves)
+        {
+            if (move.delta >= -EPSILON)
+                break;
+            if (changed[move.a] || changed[move.b])
+                continue;
+            if (move.exchange)
+                swap(routes[move.a][move.i], routes[move.b][move.j]);
+            else
+            {
+                int stop = routes[move.a][move.i];
+                routes[move.a].erase(routes[move.a].begin() + move.i);
+                routes[move.b].insert(routes[move.b].begin() + move.j, stop);
+            }
+            changed[move.a] = changed[move.b] = true;
+            improved = true;
+        }
+        if (!improved)
+            break;
     }
-    oldCrowDistance += distanceEarthMiles(startLocation, depot);   //have to go back to depot
-    newCrowDistance = oldCrowDistance;
+
+    tours.assign(drivers, vector<size_t>());
+    tourDistances.assign(drivers, 0);
+    for (int r = 0; r != drivers; r++)
+    {
+        tours[r].assign(routes[r].begin(), routes[r].end());
+        tourDistances[r] = (connected ? routeCost(routes[r], cost, stops) : numeric_limits<double>::infinity());
+    }
+}
+
+chrono::steady_clock::time_point DeliveryOptimizerImpl::deadlineAfter(double seconds)
+{
+    return chrono::steady_clock::now() + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(seconds));
+}
+
+bool DeliveryOptimizerImpl::roadCost(const DistanceMatrix& roadDistances, vector<double>& cost) const
+{
+    //copies the matrix into a cost table; false if some stop can't be reached from another
+    int stops = (int)roadDistances.size();
+    cost.resize((size_t)stops * stops);
+    bool connected = true;
+    for (int i = 0; i != stops; i++)
+    {
+        for (int j = 0; j != stops; j++)
+        {
+            cost[(size_t)i * stops + j] = roadDistances.distance(i, j);
+            connected = connected && cost[(size_t)i * stops + j] != numeric_limits<double>::infinity();
+        }
+    }
+    return connected;
+}
+
+void DeliveryOptimizerImpl::initialFleetRoutes(const vector<double>& cost, int stops, int drivers, size_t capacity, vector<vector<int>>& routes) const
+{
+    //start each route at the stop farthest from the depot and from the routes already started, then insert the
+    //other stops, farthest from the depot first, wherever they add the least distance to a route with room
+    vector<bool> placed(stops, false);
+    vector<double> separation(cost.begin(), cost.begin() + stops);   //from each stop to the depot or the closest route start
+    for (int r = 0; r != drivers && r < stops - 1; r++)
+    {
+        int farthest = -1;
+        for (int s = 1; s != stops; s++)
+        {
+            if (!placed[s] && (farthest < 0 || separation[s] > separation[farthest]))
+                farthest = s;
+        }
+        placed[farthest] = true;
+        routes[r].push_back(farthest);
+        for (int s = 1; s != stops; s++)
+            separation[s] = min(separation[s], cost[(size_t)farthest * stops + s]);
+    }
+
+    vector<int> rest;
+    for (int s = 1; s != stops; s++)
+    {
+        if (!placed[s])
+            rest.push_back(s);
+    }
+    sort(rest.begin(), rest.end(), [&](int x, int y) { return cost[x] > cost[y]; });
+    for (int stop : rest)
+    {
+        int bestRoute = -1;
+        size_t bestAt = 0;
+        double bestIncrease = numeric_limits<double>::infinity();
+        for (int r = 0; r != drivers; r++)
+        {
+            if (routes[r].size() >= capacity)
+                continue;
+            for (size_t at = 0; at <= routes[r].size(); at++)
+            {
+                int prev = (at == 0 ? 0 : routes[r][at - 1]), next = (at == routes[r].size() ? 0 : routes[r][at]);
+                double increase = cost[(size_t)prev * stops + stop] + cost[(size_t)stop * stops + next] - cost[(size_t)prev * stops + next];
+                if (increase < bestIncrease)
+                {
+                    bestIncrease = increase;
+                    bestRoute = r;
+                    bestAt = at;
+                }
+            }
+        }
+        routes[bestRoute].insert(routes[bestRoute].begin() + bestAt, stop);
+    }
+}
+
+DeliveryOptimizerImpl::FleetMove DeliveryOptimizerImpl::bestMoveBetween(const vector<vector<int>>& routes, int a, int b, const vector<double>& cost, int stops, size_t capacity,
+    chrono::steady_clock::time_point deadline) const
+{
+    //a scan cut short by the deadline still returns the best move it has seen, which is as valid as any other
+    //stop p of a route, the depot before the first stop and after the last
+    auto stopAt = [&](int r, int p) { return (p < 0 || p >= (int)routes[r].size()) ? 0 : routes[r][p]; };
+    auto c = [&](int x, int y) { return cost[(size_t)x * stops + y]; };
+
+    FleetMove best = { 0, false, a, b, 0, 0 };
+    for (int side = 0; side != 2; side++)   //relocate a stop from one route into the other, both ways round
+    {
+        int from = (side == 0 ? a : b), to = (side == 0 ? b : a);
+        if (routes[to].size() >= capacity)
+            continue;
+        for (int i = 0; i != (int)routes[from].size() && chrono::steady_clock::now() < deadline; i++)
+        {
+            int prev = stopAt(from, i - 1), stop = routes[from][i], next = stopAt(from, i + 1);
+            double removeGain = c(prev, stop) + c(stop, next) - c(prev, next);
+            for (int j = 0; j <= (int)routes[to].size(); j++)
+            {
+                int before = stopAt(to, j - 1), after = stopAt(to, j);
+                double delta = c(before, stop) + c(stop, after) - c(before, after) - removeGain;
+                if (delta < best.delta)
+                {
+                    FleetMove move = { delta, false, from, to, i, j };
+                    best = move;
+                }
+            }
+        }
+    }
+
+    for (int i = 0; i != (int)routes[a].size() && chrono::steady_clock::now() < deadline; i++)   //exchange a stop of each route, each taking the other's place
+    {
+        int prevA = stopAt(a, i - 1), s = routes[a][i], nextA = stopAt(a, i + 1);
+        for (int j = 0; j != (int)routes[b].size(); j++)
+        {
+            int prevB = stopAt(b, j - 1), t = routes[b][j], nextB = stopAt(b, j + 1);
+            double delta = c(prevA, t) + c(t, nextA) - c(prevA, s) - c(s, nextA)
+                         + c(prevB, s) + c(s, nextB) - c(prevB, t) - c(t, nextB);
+            if (delta < best.delta)
+            {
+                FleetMove move = { delta, true, a, b, i, j };
+                best = move;
+            }
+        }
+    }
+    return best;
+}
+
+void DeliveryOptimizerImpl::optimizeFleetRoute(vector<int>& route, const vector<double>& cost, int stops, chrono::steady_clock::time_point deadline) const
+{
+    //improve one route's order as a tour of its own, the depot and the route's stops, starting from the order it has
+    int routeStops = (int)route.size() + 1;
+    vector<double> routeCostTable((size_t)routeStops * routeStops);
+    for (int i = 0; i != routeStops; i++)
+    {
+        for (int j = 0; j != routeStops; j++)
+            routeCostTable[(size_t)i * routeStops + j] = cost[(size_t)(i == 0 ? 0 : route[i - 1]) * stops + (j == 0 ? 0 : route[j - 1])];
+    }
+
+    vector<int> tour(routeStops);
+    for (int i = 0; i != routeStops; i++)
+        tour[i] = i;
+    improveTour(tour, routeCostTable, routeStops, deadline);
+    vector<int> reordered;
+    reordered.reserve(route.size());
+    for (int k = 1; k != routeStops; k++)
+        reordered.push_back(route[tour[k] - 1]);
+    route.swap(reordered);
+}
+
+double DeliveryOptimizerImpl::routeCost(const vector<int>& route, const vector<double>& cost, int stops) const
+{
+    double total = 0;
+    int prev = 0;
+    for (int stop : route)
+    {
+        total += cost[(size_t)prev * stops + stop];
+        prev = stop;
+    }
+    return total + cost[(size_t)prev * stops];
+}
+
+void DeliveryOptimizerImpl::optimizeTour(const vector<double>& cost, int stops, vector<int>& tour, double& oldDistance, double& newDistance,
+    chrono::steady_clock::time_point deadline) const
+{
+    vector<int> original(stops);
+    for (int i = 0; i != stops; i++)
+        original[i] = i;
+    oldDistance = tourCost(original, cost, stops);
+
+    nearestNeighbourTour(tour, cost, stops);
+    improveTour(tour, cost, stops, deadline);
+
+    newDistance = tourCost(tour, cost, stops);
+    if (newDistance >= oldDistance)   //never hand back an order worse than the one given
+    {
+        newDistance = oldDistance;
+        tour.swap(original);
+    }
+}
+
+void DeliveryOptimizerImpl::improveTour(vector<int>& tour, const vector<double>& cost, int stops, chrono::steady_clock::time_point deadline) const
+{
+    while (chrono::steady_clock::now() < deadline)   //each pass applies every improving move it finds
+    {
+        bool improved = improveTwoOpt(tour, cost, stops, deadline);
+        improved = improveOrOpt(tour, cost, stops, deadline) || improved;
+        if (!improved)
+            break;
+    }
+}
+
+void DeliveryOptimizerImpl::reorder(vector<DeliveryRequest>& deliveries, const vector<int>& tour) const
+{
+    vector<DeliveryRequest> reordered;
+    reordered.reserve(deliveries.size());
+    for (size_t i = 1; i != tour.size(); i++)
+        reordered.push_back(deliveries[tour[i] - 1]);
+    deliveries.swap(reordered);
+}
+
+double DeliveryOptimizerImpl::tourCost(const vector<int>& tour, const vector<double>& cost, int stops) const
+{
+    double total = 0;
+    for (int i = 0; i != stops; i++)
+        total += cost[(size_t)tour[i] * stops + tour[(i + 1) % stops]];
+    return total;
+}
+
+void DeliveryOptimizerImpl::nearestNeighbourTour(vector<int>& tour, const vector<double>& cost, int stops) const
+{
+    vector<bool> visited(stops, false);
+    tour.assign(1, 0);
+    visited[0] = true;
+    for (int k = 1; k != stops; k++)   //always go to the closest stop not yet visited
+    {
+        int from = tour.back();
+        int closest = -1;
+        for (int j = 1; j != stops; j++)
+        {
+            if (!visited[j] && (closest < 0 || cost[(size_t)from * stops + j] < cost[(size_t)from * stops + closest]))
+                closest = j;
+        }
+        visited[closest] = true;
+        tour.push_back(closest);
+    }
+}
+
+bool DeliveryOptimizerImpl::improveTwoOpt(vector<int>& tour, const vector<double>& cost, int stops, chrono::steady_clock::time_point deadline) const
+{
+    //replaces legs a->b and c->d with a->c and b->d by reversing the stops from b to c
+    const double EPSILON = 1e-12;   //ignore gains too small to be anything but rounding
+    bool improved = false;
+    for (int i = 0; i < stops - 2 && chrono::steady_clock::now() < deadline; i++)
+    {
+        for (int j = i + 2; j < stops; j++)
+        {
+            if (i == 0 && j == stops - 1)   //the two legs share the depot
+                continue;
+            int a = tour[i], b = tour[i + 1], c = tour[j], d = tour[(j + 1) % stops];
+            double delta = cost[(size_t)a * stops + c] + cost[(size_t)b * stops + d]
+                         - cost[(size_t)a * stops + b] - cost[(size_t)c * stops + d];
+            if (delta < -EPSILON)
+            {
+                reverse(tour.begin() + i + 1, tour.begin() + j + 1);
+                improved = true;
+            }
+        }
+    }
+    return improved;
+}
+
+bool DeliveryOptimizerImpl::improveOrOpt(vector<int>& tour, const vector<double>& cost, int stops, chrono::steady_clock::time_point deadline) const
+{
+    //moves a run of up to MAX_OR_OPT_LENGTH consecutive stops, forwards or reversed, to between two other stops
+    const double EPSILON = 1e-12;
+    bool improved = false;
+    for (int length = 1; length <= MAX_OR_OPT_LENGTH; length++)
+    {
+        for (int i = 1; i + length <= stops && chrono::steady_clock::now() < deadline; i++)
+        {
+            int prev = tour[i - 1], first = tour[i], last = tour[i + length - 1], next = tour[(i + length) % stops];
+            double removeGain = cost[(size_t)prev * stops + first] + cost[(size_t)last * stops + next] - cost[(size_t)prev * stops + next];
+
+            int bestJ = -1;
+            bool bestReversed = false;
+            double bestDelta = -EPSILON;
+            for (int j = 0; j != stops; j++)   //insert between tour[j] and the stop after it
+            {
+                if (j >= i - 1 && j < i + length)   //that leg touches the run itself
+                    continue;
+                int a = tour[j], b = tour[(j + 1) % stops];
+                double base = cost[(size_t)a * stops + b];
+                double forward = cost[(size_t)a * stops + first] + cost[(size_t)last * stops + b] - base - removeGain;
+                double reversed = cost[(size_t)a * stops + last] + cost[(size_t)first * stops + b] - base - removeGain;
+                if (forward < bestDelta)
+                {
+                    bestDelta = forward;
+                    bestJ = j;
+                    bestReversed = false;
+                }
+                if (reversed < bestDelta)
+                {
+                    bestDelta = reversed;
+                    bestJ = j;
+                    bestReversed = true;
+                }
+            }
+            if (bestJ < 0)
+                continue;
+
+            vector<int> run(tour.begin() + i, tour.begin() + i + length);
+            if (bestReversed)
+                reverse(run.begin(), run.end());
+            int insertAfter = tour[bestJ];
+            tour.erase(tour.begin() + i, tour.begin() + i + length);
+            int at = (int)(find(tour.begin(), tour.end(), insertAfter) - tour.begin()) + 1;
+            tour.insert(tour.begin() + at, run.begin(), run.end());
+            improved = true;
+        }
+    }
+    return improved;
 }
 
 //******************** DeliveryOptimizer functions ****************************
@@ -71,3 +529,28 @@ void DeliveryOptimizer::optimizeDeliveryOrder(
 {
     return m_impl->optimizeDeliveryOrder(depot, deliveries, oldCrowDistance, newCrowDistance);
 }
+
+void DeliveryOptimizer::optimizeDeliveryOrder(
+    vector<DeliveryRequest>& deliveries,
+    const DistanceMatrix& roadDistances,
+    vector<size_t>& stopOrder,
+    double& oldDistance,
+    double& newDistance) const
+{
+    return m_impl->optimizeDeliveryOrder(deliveries, roadDistances, stopOrder, oldDistance, newDistance);
+}
+
+void DeliveryOptimizer::assignDeliveries(
+    const DistanceMatrix& roadDistances,
+    int drivers,
+    double timeBudget,
+    vector<vector<size_t>>& tours,
+    vector<double>& tourDistances) const
+{
+    return m_impl->assignDeliveries(roadDistances, drivers, timeBudget, tours, tourDistances);
+}
+
+void DeliveryOptimizer::setTimeBudget(double seconds)
+{
+    m_impl->setTimeBudget(seconds);
+}
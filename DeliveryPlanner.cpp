@@ -1,5 +1,10 @@
 #include "provided.h"
+#include "ThreadPool.h"
 #include <vector>
+#include <list>
+#include <utility>
+#include <chrono>
+#include <algorithm>
 using namespace std;
 
 //Uses contructed routes to generate directions based upon such routes
@@ -13,9 +18,28 @@ public:
         const GeoCoord& depot,
         const vector<DeliveryRequest>& deliveries,
         vector<DeliveryCommand>& commands,
-        double& totalDistanceTravelled) const;
+        double& totalDistanceTravelled,
+        DeliveryPlanStats* stats) const;
+    DeliveryResult generateFleetPlan(
+        const GeoCoord& depot,
+        const vector<DeliveryRequest>& deliveries,
+        int drivers,
+        double timeBudget,
+        vector<vector<DeliveryCommand>>& commands,
+        vector<double>& distances,
+        double& totalDistanceTravelled,
+        DeliveryPlanStats* stats) const;
 
 private:
+    static double secondsSince(chrono::steady_clock::time_point start);
+    static void addSearchStats(const DistanceMatrix& roadDistances, DeliveryPlanStats& stats);
+    DeliveryResult planTour(
+        const DistanceMatrix& roadDistances,
+        const vector<DeliveryRequest>& orderedDeliveries,
+        vector<size_t> stopOrder,
+        vector<DeliveryCommand>& commands,
+        double& totalDistanceTravelled,
+        DeliveryPlanStats& stats) const;
     void getTravelDirection(string& travelDirection, const double& angle) const;
     void proceedCommand(vector<DeliveryCommand>& commands, const GeoCoord& startCoord, const StreetSegment& endSeg, const double& startAngle) const;
 
@@ -38,81 +62,153 @@ DeliveryResult DeliveryPlannerImpl::generateDeliveryPlan(
     const GeoCoord& depot,
     const vector<DeliveryRequest>& deliveries,
     vector<DeliveryCommand>& commands,        
-    double& totalDistanceTravelled) const
+    double& totalDistanceTravelled,
+    DeliveryPlanStats* stats) const
 {
-    double oldCrowDistance = 0;
-    double newCrowDistance = 0;
+    DeliveryPlanStats unused;
+    DeliveryPlanStats& planStats = (stats != nullptr ? *stats : unused);
+    planStats = DeliveryPlanStats();
+
+    //road distances between every pair of stops (the depot is stop 0), from one search per stop; the legs of the
+    //chosen order are then read back from those searches rather than routed again
+    chrono::steady_clock::time_point phaseStart = chrono::steady_clock::now();
+    vector<GeoCoord> stops(1, depot);
+    for (vector<DeliveryRequest>::const_iterator it = deliveries.begin(); it != deliveries.end(); it++)
+        stops.push_back(it->location);
+    DistanceMatrix roadDistances(m_streetMap);
+    if (roadDistances.compute(stops) == BAD_COORD)
+        return BAD_COORD;
+    planStats.matrixSeconds = secondsSince(phaseStart);
+    addSearchStats(roadDistances, planStats);
+
+    phaseStart = chrono::steady_clock::now();
+    double oldDistance = 0;
+    double newDistance = 0;
     vector<DeliveryRequest> betterDeliveries = deliveries;
-    m_deliveryOptimizer->optimizeDeliveryOrder(depot, betterDeliveries, oldCrowDistance, newCrowDistance);
+    vector<size_t> stopOrder;   //stop number of each of betterDeliveries
+    m_deliveryOptimizer->optimizeDeliveryOrder(betterDeliveries, roadDistances, stopOrder, oldDistance, newDistance);
+    planStats.optimizeSeconds = secondsSince(phaseStart);
 
-    PointToPointRouter router(m_streetMap);  
-    vector<list<StreetSegment>> deliveryRoute; 
-    totalDistanceTravelled = 0;
-    list<StreetSegment> currentRoute;
-    GeoCoord start = depot;
-    double distStartToFinish = 0;
+    phaseStart = chrono::steady_clock::now();
+    DeliveryResult result = planTour(roadDistances, betterDeliveries, stopOrder, commands, totalDistanceTravelled, planStats);
+    planStats.directionsSeconds = secondsSince(phaseStart);
+    return result;
+}
 
-    for (vector<DeliveryRequest>::iterator it = betterDeliveries.begin(); it != betterDeliveries.end(); it++)
+DeliveryResult DeliveryPlannerImpl::generateFleetPlan(
+    const GeoCoord& depot,
+    const vector<DeliveryRequest>& deliveries,
+    int drivers,
+    double timeBudget,
+    vector<vector<DeliveryCommand>>& commands,
+    vector<double>& distances,
+    double& totalDistanceTravelled,
+    DeliveryPlanStats* stats) const
+{
+    DeliveryPlanStats unused;
+    DeliveryPlanStats& planStats = (stats != nullptr ? *stats : unused);
+    planStats = DeliveryPlanStats();
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    vector<GeoCoord> stops(1, depot);
+    for (vector<DeliveryRequest>::const_iterator it = deliveries.begin(); it != deliveries.end(); it++)
+        stops.push_back(it->location);
+    DistanceMatrix roadDistances(m_streetMap);
+    if (roadDistances.compute(stops) == BAD_COORD)
+        return BAD_COORD;
+    planStats.matrixSeconds = secondsSince(start);
+    addSearchStats(roadDistances, planStats);
+
+    //whatever the matrix didn't use of the budget goes to sharing out the deliveries
+    chrono::steady_clock::time_point phaseStart = chrono::steady_clock::now();
+    vector<vector<size_t>> tours;
+    vector<double> tourDistances;
+    m_deliveryOptimizer->assignDeliveries(roadDistances, drivers, max(0.0, timeBudget - planStats.matrixSeconds), tours, tourDistances);
+    planStats.optimizeSeconds = secondsSince(phaseStart);
+
+    phaseStart = chrono::steady_clock::now();
+    commands.assign(tours.size(), vector<DeliveryCommand>());
+    distances.assign(tours.size(), 0);
+    totalDistanceTravelled = 0;
+    for (size_t d = 0; d != tours.size(); d++)
     {
-        GeoCoord finish = (*it).location;
-       
-        distStartToFinish = 0;
-        DeliveryResult deliveryResult = router.generatePointToPointRoute(start, finish, currentRoute, distStartToFinish);  
-        if (deliveryResult == NO_ROUTE)
+        if (tours[d].empty())   //more drivers than deliveries: this one stays at the depot
+            continue;
+        vector<DeliveryRequest> driverDeliveries;
+        for (size_t stop : tours[d])
+            driverDeliveries.push_back(deliveries[stop - 1]);
+        if (planTour(roadDistances, driverDeliveries, tours[d], commands[d], distances[d], planStats) == NO_ROUTE)
             return NO_ROUTE;
-        else if (deliveryResult == BAD_COORD)
-            return BAD_COORD;
-        else
-        {
-            totalDistanceTravelled += distStartToFinish; 
-            deliveryRoute.push_back(currentRoute);   
-            start = finish;      
-        }
+        totalDistanceTravelled += distances[d];
     }
+    planStats.directionsSeconds = secondsSince(phaseStart);
+    return DELIVERY_SUCCESS;
+}
 
-    distStartToFinish = 0;
-    DeliveryResult deliveryResult = router.generatePointToPointRoute(start, depot, currentRoute, distStartToFinish);
-    if (deliveryResult == NO_ROUTE)
-        return NO_ROUTE;
-    else if (deliveryResult == BAD_COORD)
-        return BAD_COORD;
-    else
+double DeliveryPlannerImpl::secondsSince(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+void DeliveryPlannerImpl::addSearchStats(const DistanceMatrix& roadDistances, DeliveryPlanStats& stats)
+{
+    for (size_t stop = 0; stop != roadDistances.size(); stop++)
+        stats.searches += roadDistances.searchStats(stop);
+}
+
+DeliveryResult DeliveryPlannerImpl::planTour(
+    const DistanceMatrix& roadDistances,
+    const vector<DeliveryRequest>& orderedDeliveries,
+    vector<size_t> stopOrder,
+    vector<DeliveryCommand>& commands,
+    double& totalDistanceTravelled,
+    DeliveryPlanStats& stats) const
+{
+    //orderedDeliveries[i] is the delivery at matrix stop stopOrder[i]; the tour starts and ends at the depot, stop 0
+    //with the order fixed the legs are independent: read them back from the matrix side by side, then add them up in order
+    stopOrder.push_back(0);   //last leg goes back to the depot
+    vector<Route> deliveryRoute(stopOrder.size());
+    vector<double> legDistance(stopOrder.size(), 0);
+    vector<DeliveryResult> legResult(stopOrder.size());
+    ThreadPool::shared().parallelFor(stopOrder.size(), [&](size_t leg) {
+        size_t start = (leg == 0 ? 0 : stopOrder[leg - 1]);
+        legResult[leg] = roadDistances.getRoute(start, stopOrder[leg], deliveryRoute[leg], legDistance[leg]);
+    });
+
+    totalDistanceTravelled = 0;
+    for (size_t leg = 0; leg != stopOrder.size(); leg++)
     {
-        totalDistanceTravelled += distStartToFinish;
-        deliveryRoute.push_back(currentRoute);  
+        if (legResult[leg] == NO_ROUTE)
+            return NO_ROUTE;
+        totalDistanceTravelled += legDistance[leg];
+        stats.legs.push_back(roadDistances.searchStats(leg == 0 ? 0 : stopOrder[leg - 1]));
     }
 
-    vector<DeliveryRequest>::iterator request = betterDeliveries.begin();
-    for (int i = 0; i != deliveryRoute.size(); i++)
+    vector<DeliveryRequest>::const_iterator request = orderedDeliveries.begin();
+    for (size_t i = 0; i != deliveryRoute.size(); i++)
     {
-        //GET ROUTE
-        list<StreetSegment> itemRoute = deliveryRoute[i];
-
-        if (currentRoute.size() < 1)  //if no routes to traverse, we already completed all our deliveries
-        {
-            DeliveryCommand done;
-            string deliveryItem = request->item;  
-            done.initAsDeliverCommand(deliveryItem);  
-            request++;
-            continue;
-        }
+        //GET ROUTE.  A leg with no segments (a stop at the same place as the one before) gives no directions, but its
+        //delivery is still made below
+        const Route& itemRoute = deliveryRoute[i];
 
-        //PROCESS SEGMENTS OF ROUTE
-        list<StreetSegment>::iterator ahead = itemRoute.begin();
-        list<StreetSegment>::iterator behind = ahead;
-        while (behind != itemRoute.end())  
+        //PROCESS SEGMENTS OF ROUTE.  Streets are compared by name id; a segment is only built where a command needs it
+        size_t segments = itemRoute.size();
+        size_t ahead = 0;
+        size_t behind = ahead;
+        while (behind != segments)  
         {
             GeoCoord startCoord;
             double startAngle;
-            if (ahead == itemRoute.end())  //check if done
+            if (ahead == segments)  //check if done
             {
                 behind = ahead;
                 break;
             }
 
-            if (behind->name != ahead->name)   //turn?
+            StreetSegment aheadSeg = itemRoute.segment(ahead);
+            if (itemRoute.nameId(behind) != itemRoute.nameId(ahead))   //turn?
             {
-                double turnAngle = angleBetween2Lines((*behind), (*ahead));
+                double turnAngle = angleBetween2Lines(itemRoute.segment(behind), aheadSeg);
                 string turnCommand;
                 if (turnAngle >= 1 && turnAngle < 180)
                     turnCommand = "left";
@@ -122,27 +218,27 @@ DeliveryResult DeliveryPlannerImpl::generateDeliveryPlan(
                 if (turnCommand != "")  
                 {
                     DeliveryCommand turn;
-                    string turnStreetName = (*ahead).name;  
+                    string turnStreetName = aheadSeg.name;  
                     turn.initAsTurnCommand(turnCommand, turnStreetName);
                     commands.push_back(turn);
                 }
-                startCoord = (*ahead).start;  
-                startAngle = angleOfLine(*ahead);
+                startCoord = aheadSeg.start;  
+                startAngle = angleOfLine(aheadSeg);
                 behind = ahead;
                 ahead++;
             }
             else
             {
-                startCoord = (*ahead).start;  
-                startAngle = angleOfLine(*ahead);
+                startCoord = aheadSeg.start;  
+                startAngle = angleOfLine(aheadSeg);
             }
 
-            while (ahead != itemRoute.end() && behind->name == ahead->name)   
+            while (ahead != segments && itemRoute.nameId(behind) == itemRoute.nameId(ahead))   
             {
                 behind = ahead;
                 ahead++;
             }
-            StreetSegment endSeg = (*behind);  
+            const StreetSegment endSeg = itemRoute.segment(behind);  
             proceedCommand(commands, startCoord, endSeg, startAngle);
         }
 
@@ -232,7 +328,21 @@ DeliveryResult DeliveryPlanner::generateDeliveryPlan(
     const GeoCoord& depot,
     const vector<DeliveryRequest>& deliveries,
     vector<DeliveryCommand>& commands,
-    double& totalDistanceTravelled) const
+    double& totalDistanceTravelled,
+    DeliveryPlanStats* stats) const
+{
+    return m_impl->generateDeliveryPlan(depot, deliveries, commands, totalDistanceTravelled, stats);
+}
+
+DeliveryResult DeliveryPlanner::generateFleetPlan(
+    const GeoCoord& depot,
+    const vector<DeliveryRequest>& deliveries,
+    int drivers,
+    double timeBudget,
+    vector<vector<DeliveryCommand>>& commands,
+    vector<double>& distances,
+    double& totalDistanceTravelled,
+    DeliveryPlanStats* stats) const
 {
-    return m_impl->generateDeliveryPlan(depot, deliveries, commands, totalDistanceTravelled);
+    return m_impl->generateFleetPlan(depot, deliveries, drivers, timeBudget, commands, distances, totalDistanceTravelled, stats);
 }
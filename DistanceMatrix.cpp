@@ -0,0 +1,419 @@
+#include "provided.h"
+#include "ThreadPool.h"
+#include "RouterWorkspace.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <list>
+#include <string>
+#include <vector>
+using namespace std;
+
+//Shortest road distances between every pair of a set of points.  Each point gets one Dijkstra search that stops as
+//soon as every other point has been reached, instead of one search per pair.  The searches are independent and run
+//on the shared thread pool.  Of each search's tree only the routes to the other points are kept, sharing the edges
+//they have in common, so the route behind any entry can be read back without searching again.
+//A point that isn't a map node is snapped to the closest point on a segment, and enters the road network through
+//that segment's two ends ("anchors"), each at the distance along the segment from the snapped point.  A point more than
+//MAX_SNAP_MILES from every segment is taken as a bad coordinate (say latitude and longitude swapped), not snapped
+
+class DistanceMatrixImpl
+{
+public:
+    DistanceMatrixImpl(const StreetMap* sm);
+    ~DistanceMatrixImpl();
+    DeliveryResult compute(const vector<GeoCoord>& points);
+    size_t size() const;
+    double distance(size_t from, size_t to) const;
+    DeliveryResult getRoute(size_t from, size_t to, Route& route, double& totalDistanceTravelled) const;
+    const RouteSearchStats& searchStats(size_t from) const;
+
+private:
+    static constexpr double MAX_SNAP_MILES = 1.0;   //furthest a point may be from the streets it is snapped onto
+    static const unsigned char DIRECT = 0xFF;   //m_via value for two points on the same segment, joined along it
+    static constexpr uint32_t NO_TREE_EDGE = 0xFFFFFFFF;
+
+    struct Anchor
+    {
+        NodeId node;
+        double offset;   //miles from the point to node
+    };
+
+    struct Point
+    {
+        SnappedPoint snapped;   //edge is NO_EDGE when the point is a map node itself
+        string streetName;      //of the snapped segment
+        NameId streetNameId;
+        vector<Anchor> anchors;
+    };
+
+    struct TreeEdge   //a map edge of a kept route, and the tree edge before it (NO_TREE_EDGE at a source anchor)
+    {
+        EdgeId edge;
+        uint32_t previous;
+    };
+
+    struct SearchScratch   //per node arrays a search needs besides its labels; all false / NO_TREE_EDGE between searches
+    {
+        vector<bool> isTarget;
+        vector<uint32_t> treeIndex;   //node -> the kept tree edge that reaches it
+        vector<NodeId> path;
+    };
+
+    bool locate(const GeoCoord& gc, Point& point) const;
+    void searchFrom(size_t source, RouterWorkspace& ws, SearchScratch& scratch);
+    void keepRoutes(size_t source, const RouterWorkspace& ws, SearchScratch& scratch);
+    NodeId edgeSource(EdgeId e) const;
+
+    const StreetMap* m_streetMap;
+    vector<Point> m_points;
+    vector<double> m_distances;            //row major, m_distances[from * size() + to]
+    vector<unsigned char> m_via;           //same layout, the anchor of 'to' its route arrives through, or DIRECT
+    vector<uint32_t> m_routeEnds;          //same layout, the last tree edge of the route, NO_TREE_EDGE if it has none
+    vector<vector<TreeEdge>> m_trees;      //per point, the edges of its routes to the others
+    vector<RouteSearchStats> m_searchStats;   //per point, the work its search did
+};
+
+DistanceMatrixImpl::DistanceMatrixImpl(const StreetMap* sm)
+    :m_streetMap(sm)
+{
+}
+
+DistanceMatrixImpl::~DistanceMatrixImpl()
+{
+}
+
+DeliveryResult DistanceMatrixImpl::compute(const vector<GeoCoord>& points)
+{
+    m_points.clear();
+    m_distances.clear();
+    m_via.clear();
+    m_routeEnds.clear();
+    m_trees.clear();
+    m_searchStats.clear();
+    m_points.resize(points.size());
+    for (size_t i = 0; i != points.size(); i++)
+    {
+        if (!locate(points[i], m_points[i]))
+        {
+            m_points.clear();
+            return BAD_COORD;
+        }
+    }
+
+    m_distances.assign(points.size() * points.size(), numeric_limits<double>::infinity());
+    m_via.assign(points.size() * points.size(), 0);
+    m_routeEnds.assign(points.size() * points.size(), NO_TREE_EDGE);
+    m_trees.resize(points.size());
+    m_searchStats.assign(points.size(), RouteSearchStats());
+
+    //one task per thread, each taking the next point not yet searched, so a slow search doesn't hold up the rest.
+    //The per node arrays belong to the thread and outlive the matrix, so only a thread's first search on a map sizes them
+    ThreadPool& pool = ThreadPool::shared();
+    atomic<size_t> nextSource(0);
+    pool.parallelFor(min((size_t)pool.size(), points.size()), [&](size_t) {
+        thread_local RouterWorkspace workspace;
+        thread_local SearchScratch scratch;
+        for (size_t source = nextSource++; source < m_points.size(); source = nextSource++)
+            searchFrom(source, workspace, scratch);
+    });
+    return DELIVERY_SUCCESS;
+}
+
+bool DistanceMatrixImpl::locate(const GeoCoord& gc, Point& point) const
+{
+    point.anchors.clear();
+    if (!(fabs(gc.latitude) <= 90) || !(fabs(gc.longitude) <= 180))   //also false for NaN
+        return false;
+    NodeId node;
+    if (m_streetMap->getNodeId(CoordKey(gc), node))
+    {
+        point.snapped = SnappedPoint();
+        point.snapped.from = point.snapped.to = node;
+        point.snapped.point = gc;
+        Anchor a = { node, 0 };
+        point.anchors.push_back(a);
+        return true;
+    }
+
+    SnappedPoint& s = point.snapped;
+    if (!m_streetMap->snapToSegment(gc, s) || s.offMapMiles > MAX_SNAP_MILES)
+        return false;
+    double length = m_streetMap->graph().edgeLengths[s.edge];
+    point.streetNameId = m_streetMap->graph().edgeNames[s.edge];
+    point.streetName = m_streetMap->graph().streetName(point.streetNameId);
+    if (s.fraction != 1)
+    {
+        Anchor a = { s.from, s.fraction * length };
+        point.anchors.push_back(a);
+    }
+    if (s.fraction != 0)
+    {
+        Anchor a = { s.to, (1 - s.fraction) * length };
+        point.anchors.push_back(a);
+    }
+    return true;
+}
+
+void DistanceMatrixImpl::searchFrom(size_t source, RouterWorkspace& ws, SearchScratch& scratch)
+{
+    //writes only this source's row of the matrix, its own tree and its own stats, so searches can run side by side
+    chrono::steady_clock::time_point began = chrono::steady_clock::now();
+    RouteSearchStats& stats = m_searchStats[source];
+    const StreetGraph& g = m_streetMap->graph();
+    size_t allocationsBefore = ws.allocations();
+    ws.beginSearch(g.nodeCount, 1);   //side 0 only
+    SearchHeap& open = ws.queue(0);
+    vector<bool>& isTarget = scratch.isTarget;
+    if (isTarget.size() < g.nodeCount)
+    {
+        stats.allocations += 2;
+        isTarget.resize(g.nodeCount, false);
+        scratch.treeIndex.resize(g.nodeCount, NO_TREE_EDGE);
+    }
+    size_t targetsLeft = 0;   //distinct anchor nodes among the points, not yet settled
+    for (size_t i = 0; i != m_points.size(); i++)
+    {
+        for (const Anchor& a : m_points[i].anchors)
+        {
+            if (!isTarget[a.node])
+            {
+                isTarget[a.node] = true;
+                targetsLeft++;
+            }
+        }
+    }
+
+    //the search starts from every anchor of the source at once, each already its offset along the way
+    const Point& from = m_points[source];
+    for (const Anchor& a : from.anchors)
+    {
+        ws.setLabel(0, a.node, a.offset, NO_NODE, NO_EDGE);
+        open.push(SearchEntry(a.offset, a.offset, a.node));
+        stats.heapPushes++;
+    }
+    stats.peakFrontier = open.size();
+    while (!open.empty() && targetsLeft != 0)
+    {
+        SearchEntry cur = open.top();
+        open.pop();
+        if (cur.distanceSoFar > ws.distance(0, cur.node))   //stale entry
+            continue;
+        stats.nodesSettled++;
+        if (isTarget[cur.node])
+        {
+            isTarget[cur.node] = false;
+            targetsLeft--;
+        }
+        for (EdgeId e : g.edgesFrom(cur.node))
+        {
+            stats.edgesRelaxed++;
+            NodeId next = g.edgeTargets[e];
+            double d = cur.distanceSoFar + g.edgeLengths[e];
+            if (ws.distance(0, next) <= d)
+                continue;
+            ws.setLabel(0, next, d, cur.node, e);
+            open.push(SearchEntry(d, d, next));
+            stats.heapPushes++;
+        }
+        stats.peakFrontier = max(stats.peakFrontier, open.size());
+    }
+    for (size_t i = 0; i != m_points.size() && targetsLeft != 0; i++)   //unreachable targets, left set
+    {
+        for (const Anchor& a : m_points[i].anchors)
+            isTarget[a.node] = false;
+    }
+
+    for (size_t to = 0; to != m_points.size(); to++)
+    {
+        const Point& target = m_points[to];
+        double best = numeric_limits<double>::infinity();
+        unsigned char via = 0;
+        if (to == source)
+        {
+            best = 0;
+            via = DIRECT;
+        }
+        else
+        {
+            for (size_t i = 0; i != target.anchors.size(); i++)
+            {
+                double d = ws.distance(0, target.anchors[i].node) + target.anchors[i].offset;
+                if (d < best)
+                {
+                    best = d;
+                    via = (unsigned char)i;
+                }
+            }
+            //two points on the same segment may be closer along it than through either end
+            if (from.snapped.edge != NO_EDGE && from.snapped.edge == target.snapped.edge)
+            {
+                double d = fabs(from.snapped.fraction - target.snapped.fraction) * g.edgeLengths[from.snapped.edge];
+                if (d <= best)
+                {
+                    best = d;
+                    via = DIRECT;
+                }
+            }
+        }
+        m_distances[source * m_points.size() + to] = best;
+        m_via[source * m_points.size() + to] = via;
+    }
+
+    size_t treeCapacity = m_trees[source].capacity();
+    keepRoutes(source, ws, scratch);
+    stats.allocations += ws.allocations() - allocationsBefore + (m_trees[source].capacity() != treeCapacity ? 1 : 0);
+    stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - began).count();
+}
+
+void DistanceMatrixImpl::keepRoutes(size_t source, const RouterWorkspace& ws, SearchScratch& scratch)
+{
+    //copies the routes to the other points out of the search's labels before the next search reuses them.  Routes
+    //from one source share their first edges, so each route only adds the edges after where it leaves those kept
+    //already; that is usually far fewer than the map's nodes
+    const StreetGraph& g = m_streetMap->graph();
+    vector<TreeEdge>& tree = m_trees[source];
+    vector<uint32_t>& treeIndex = scratch.treeIndex;
+    vector<NodeId>& path = scratch.path;
+    tree.clear();
+    for (size_t to = 0; to != m_points.size(); to++)
+    {
+        size_t entry = source * m_points.size() + to;
+        if (m_via[entry] == DIRECT || m_distances[entry] == numeric_limits<double>::infinity())
+            continue;
+        path.clear();
+        NodeId n = m_points[to].anchors[m_via[entry]].node;
+        while (ws.previousEdge(0, n) != NO_EDGE && treeIndex[n] == NO_TREE_EDGE)
+        {
+            path.push_back(n);
+            n = ws.previousNode(0, n);
+        }
+        uint32_t previous = (ws.previousEdge(0, n) == NO_EDGE ? NO_TREE_EDGE : treeIndex[n]);
+        for (size_t i = path.size(); i != 0; i--)
+        {
+            TreeEdge te = { ws.previousEdge(0, path[i - 1]), previous };
+            tree.push_back(te);
+            previous = (uint32_t)tree.size() - 1;
+            treeIndex[path[i - 1]] = previous;
+        }
+        m_routeEnds[entry] = previous;
+    }
+    for (const TreeEdge& te : tree)   //the node a tree edge reaches is the one it was indexed under
+        treeIndex[g.edgeTargets[te.edge]] = NO_TREE_EDGE;
+}
+
+NodeId DistanceMatrixImpl::edgeSource(EdgeId e) const
+{
+    //edges are stored grouped by the node they leave, so that is the last node whose first edge is at or before e
+    const StreetGraph& g = m_streetMap->graph();
+    return (NodeId)(upper_bound(g.firstEdge, g.firstEdge + g.nodeCount + 1, e) - g.firstEdge - 1);
+}
+
+const RouteSearchStats& DistanceMatrixImpl::searchStats(size_t from) const
+{
+    return m_searchStats[from];
+}
+
+size_t DistanceMatrixImpl::size() const
+{
+    return m_points.size();
+}
+
+double DistanceMatrixImpl::distance(size_t from, size_t to) const
+{
+    return m_distances[from * m_points.size() + to];
+}
+
+DeliveryResult DistanceMatrixImpl::getRoute(size_t from, size_t to, Route& route, double& totalDistanceTravelled) const
+{
+    const Point& source = m_points[from];
+    const Point& target = m_points[to];
+    route.reset(m_streetMap, source.anchors[0].node);
+    double d = distance(from, to);
+    if (d == numeric_limits<double>::infinity())
+        return NO_ROUTE;
+
+    unsigned char via = m_via[from * m_points.size() + to];
+    if (via == DIRECT)
+    {
+        if (d > 0)
+            route.setLeadIn(StreetSegment(source.snapped.point, target.snapped.point, source.streetName, source.streetNameId));
+        totalDistanceTravelled = d;
+        return DELIVERY_SUCCESS;
+    }
+
+    //walk the kept tree back from the route's last edge to its first: once to find where the route begins and how
+    //many edges it has, then again to fill them in from the end
+    const Anchor& arrival = target.anchors[via];
+    const vector<TreeEdge>& tree = m_trees[from];
+    uint32_t last = m_routeEnds[from * m_points.size() + to];
+    size_t count = 0;
+    NodeId curr = arrival.node;
+    for (uint32_t t = last; t != NO_TREE_EDGE; t = tree[t].previous, count++)
+    {
+        if (tree[t].previous == NO_TREE_EDGE)
+            curr = edgeSource(tree[t].edge);
+    }
+    route.reset(m_streetMap, curr);
+    vector<EdgeId>& edges = route.edges();
+    edges.resize(count);
+    for (uint32_t t = last; t != NO_TREE_EDGE; t = tree[t].previous)
+        edges[--count] = tree[t].edge;
+    for (const Anchor& a : source.anchors)
+    {
+        if (a.node == curr && a.offset > 0)
+            route.setLeadIn(StreetSegment(source.snapped.point, m_streetMap->getNodeCoord(curr), source.streetName, source.streetNameId));
+    }
+    if (arrival.offset > 0)
+        route.setLeadOut(StreetSegment(m_streetMap->getNodeCoord(arrival.node), target.snapped.point, target.streetName, target.streetNameId));
+    totalDistanceTravelled = d;
+    return DELIVERY_SUCCESS;
+}
+
+//******************** DistanceMatrix functions *******************************
+
+DistanceMatrix::DistanceMatrix(const StreetMap* sm)
+{
+    m_impl = new DistanceMatrixImpl(sm);
+}
+
+DistanceMatrix::~DistanceMatrix()
+{
+    delete m_impl;
+}
+
+DeliveryResult DistanceMatrix::compute(const vector<GeoCoord>& points)
+{
+    return m_impl->compute(points);
+}
+
+size_t DistanceMatrix::size() const
+{
+    return m_impl->size();
+}
+
+double DistanceMatrix::distance(size_t from, size_t to) const
+{
+    return m_impl->distance(from, to);
+}
+
+DeliveryResult DistanceMatrix::getRoute(size_t from, size_t to, Route& route, double& totalDistanceTravelled) const
+{
+    return m_impl->getRoute(from, to, route, totalDistanceTravelled);
+}
+
+const RouteSearchStats& DistanceMatrix::searchStats(size_t from) const
+{
+    return m_impl->searchStats(from);
+}
+
+DeliveryResult DistanceMatrix::getRoute(size_t from, size_t to, list<StreetSegment>& route, double& totalDistanceTravelled) const
+{
+    Route compact;
+    DeliveryResult result = m_impl->getRoute(from, to, compact, totalDistanceTravelled);
+    compact.toList(route);
+    return result;
+}
@@ -2,7 +2,32 @@
 
 // Implementation for an expandable hash map
 
-const int STARTING_BUCKETS = 8;
+// Associations are stored in a single flat array using open addressing with
+// Robin Hood probing: a key lives in the first free bucket at or after its home
+// bucket, and an insert that has probed further than the current occupant takes
+// its place and carries the occupant forward.  That keeps probe lengths short and
+// even, so find() usually touches one or two adjacent buckets.  Each bucket also
+// caches the key's full hash, which means most mismatches are rejected without
+// comparing keys and growing never needs to call hasher() again.
+
+// Pointers returned by find() are invalidated by associate(), erase(), reserve()
+// and reset().
+
+// Sizes and bucket indexes are size_t, so a map can outgrow 2^31 buckets; with
+// 32-bit hashes it can address at most MAX_BUCKETS = 2^32, and reserve() or
+// associate() throws std::length_error rather than grow past that.
+
+#ifndef EXPANDABLEHASHMAP_INCLUDED
+#define EXPANDABLEHASHMAP_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+const std::size_t STARTING_BUCKETS = 8;
+const std::uint64_t MAX_BUCKETS = (std::uint64_t)1 << 32;   //one per value of a 32-bit hash
 
 template<typename KeyType, typename ValueType>
 class ExpandableHashMap
@@ -11,8 +36,12 @@ public:
 	ExpandableHashMap(double maximumLoadFactor = 0.5);
 	~ExpandableHashMap();
 	void reset();
-	int size() const;
+	std::size_t size() const;
+	void reserve(std::size_t numAssociations);
 	void associate(const KeyType& key, const ValueType& value);
+	void associate(const KeyType& key, ValueType&& value);
+	void associate(KeyType&& key, ValueType&& value);
+	bool erase(const KeyType& key);
 
 	// for a map that can't be modified, return a pointer to const ValueType
 	const ValueType* find(const KeyType& key) const;
@@ -28,36 +57,48 @@ public:
 	ExpandableHashMap& operator=(const ExpandableHashMap&) = delete;
 
 private:
-	void clearHash();
-	int getBucket(const KeyType& key, const int& capacity) const;
-	void expandHash();
-
-	struct Node {
+	struct Slot {
+		Slot(KeyType&& k, ValueType&& v) : key(std::move(k)), value(std::move(v)) {}
 		KeyType key;
 		ValueType value;
-		Node* next = nullptr;
 	};
 
-	Node** m_hashMap;
-	int m_maxSize;        //number of associations cannot exceed this
-	int m_capacity;       //total number of buckets/size of array
-	int m_size;           //number of associations currently in map
+	struct Bucket {
+		Bucket() : distance(0) {}
+		~Bucket() {}             //slot is destroyed by the map, only while the bucket is occupied
+		unsigned int hash;       //full hash of the key in this bucket
+		unsigned int distance;   //0 if empty, otherwise 1 + how far the key sits from its home bucket
+		union { Slot slot; };
+	};
+
+	void clearHash();
+	void allocateBuckets(std::size_t capacity);
+	unsigned int getHash(const KeyType& key) const;
+	std::size_t getBucket(unsigned int hash) const;
+	bool findIndex(const KeyType& key, unsigned int hash, std::size_t& index) const;
+	template<typename K, typename V> void insertNew(unsigned int hash, K&& key, V&& value);
+	void placeNew(unsigned int hash, KeyType&& key, ValueType&& value);
+	void expandHash(std::size_t newCapacity);
+
+	Bucket* m_hashMap;
+	std::size_t m_maxSize;    //number of associations cannot exceed this
+	std::size_t m_capacity;   //total number of buckets/size of array, always a power of 2
+	int m_shift;              //32 - log2(m_capacity), 0 to 32, used to pick a bucket from the top bits of a hash
+	std::size_t m_size;       //number of associations currently in map
 	double m_maxLoadFactor;
 };
 
 template<typename KeyType, typename ValueType>
 ExpandableHashMap<KeyType, ValueType>::ExpandableHashMap(double maximumLoadFactor)
-	:m_capacity(STARTING_BUCKETS), m_size(0)
+	:m_hashMap(nullptr), m_size(0)
 {
-	if (maximumLoadFactor < 0)
+	if (maximumLoadFactor <= 0)
 		maximumLoadFactor = 0.5;
+	if (maximumLoadFactor > 0.9)   //robin hood probing degrades quickly above this
+		maximumLoadFactor = 0.9;
 	m_maxLoadFactor = maximumLoadFactor;
 
-	m_hashMap = new Node * [STARTING_BUCKETS];
-	for (int i = 0; i < STARTING_BUCKETS; i++)  
-		m_hashMap[i] = nullptr;
-
-	m_maxSize = (int)(m_maxLoadFactor * STARTING_BUCKETS);
+	allocateBuckets(STARTING_BUCKETS);
 }
 
 template<typename KeyType, typename ValueType>
@@ -70,140 +111,207 @@ template<typename KeyType, typename ValueType>
 void ExpandableHashMap<KeyType, ValueType>::reset()
 {
 	clearHash();
-
-	m_capacity = STARTING_BUCKETS;
-	m_maxSize = (int)(m_maxLoadFactor * STARTING_BUCKETS);
-	m_hashMap = new Node * [STARTING_BUCKETS];
-	for (int i = 0; i < STARTING_BUCKETS; i++)  
-		m_hashMap[i] = nullptr;
-
-	m_size = 0;           
+	allocateBuckets(STARTING_BUCKETS);
+	m_size = 0;
 }
 
 template<typename KeyType, typename ValueType>
-int ExpandableHashMap<KeyType, ValueType>::size() const
+std::size_t ExpandableHashMap<KeyType, ValueType>::size() const
 {
 	return m_size;
 }
 
+template<typename KeyType, typename ValueType>
+void ExpandableHashMap<KeyType, ValueType>::reserve(std::size_t numAssociations)
+{
+	std::size_t newCapacity = m_capacity;
+	while ((std::size_t)(m_maxLoadFactor * newCapacity) < numAssociations && newCapacity < MAX_BUCKETS)
+		newCapacity *= 2;
+	if ((std::size_t)(m_maxLoadFactor * newCapacity) < numAssociations)
+		throw std::length_error("ExpandableHashMap can't hold that many associations with 32-bit hashes");
+	if (newCapacity != m_capacity)
+		expandHash(newCapacity);
+}
+
 template<typename KeyType, typename ValueType>
 void ExpandableHashMap<KeyType, ValueType>::associate(const KeyType& key, const ValueType& value)
 {
-	int bucketNum = getBucket(key, m_capacity);
-	if (find(key) == nullptr) 
+	unsigned int hash = getHash(key);
+	std::size_t index;
+	if (findIndex(key, hash, index))
+		m_hashMap[index].slot.value = value;
+	else
+		insertNew(hash, key, value);
+}
+
+template<typename KeyType, typename ValueType>
+void ExpandableHashMap<KeyType, ValueType>::associate(const KeyType& key, ValueType&& value)
+{
+	unsigned int hash = getHash(key);
+	std::size_t index;
+	if (findIndex(key, hash, index))
+		m_hashMap[index].slot.value = std::move(value);
+	else
+		insertNew(hash, key, std::move(value));
+}
+
+template<typename KeyType, typename ValueType>
+void ExpandableHashMap<KeyType, ValueType>::associate(KeyType&& key, ValueType&& value)
+{
+	unsigned int hash = getHash(key);
+	std::size_t index;
+	if (findIndex(key, hash, index))
+		m_hashMap[index].slot.value = std::move(value);
+	else
+		insertNew(hash, std::move(key), std::move(value));
+}
+
+template<typename KeyType, typename ValueType>
+bool ExpandableHashMap<KeyType, ValueType>::erase(const KeyType& key)
+{
+	std::size_t index;
+	if (!findIndex(key, getHash(key), index))
+		return false;
+
+	//backward shift: pull each following displaced key one bucket closer to home so no tombstones are needed
+	std::size_t mask = m_capacity - 1;
+	std::size_t next = (index + 1) & mask;
+	while (m_hashMap[next].distance > 1)
 	{
-		if (m_size + 1 > m_maxSize)  
-			expandHash();
-		if (m_hashMap[bucketNum] == nullptr)   
+		m_hashMap[index].slot.key = std::move(m_hashMap[next].slot.key);
+		m_hashMap[index].slot.value = std::move(m_hashMap[next].slot.value);
+		m_hashMap[index].hash = m_hashMap[next].hash;
+		m_hashMap[index].distance = m_hashMap[next].distance - 1;
+		index = next;
+		next = (next + 1) & mask;
+	}
+	m_hashMap[index].slot.~Slot();
+	m_hashMap[index].distance = 0;
+	m_size--;
+	return true;
+}
+
+template<typename KeyType, typename ValueType>
+template<typename K, typename V>
+void ExpandableHashMap<KeyType, ValueType>::insertNew(unsigned int hash, K&& key, V&& value)
+{
+	if (m_size + 1 > m_maxSize)
+		expandHash(m_capacity * 2);
+	placeNew(hash, KeyType(std::forward<K>(key)), ValueType(std::forward<V>(value)));
+	m_size++;
+}
+
+template<typename KeyType, typename ValueType>
+void ExpandableHashMap<KeyType, ValueType>::placeNew(unsigned int hash, KeyType&& key, ValueType&& value)
+{
+	//caller guarantees the key is not already in the map and that there is room for it
+	std::size_t mask = m_capacity - 1;
+	std::size_t index = getBucket(hash);
+	unsigned int distance = 1;
+	for (;;)
+	{
+		Bucket& b = m_hashMap[index];
+		if (b.distance == 0)   //empty bucket, the carried key goes here
 		{
-			Node* insert = new Node;
-			insert->key = key;
-			insert->value = value;
-			insert->next = nullptr;
-			m_hashMap[bucketNum] = insert;
+			new (&b.slot) Slot(std::move(key), std::move(value));
+			b.hash = hash;
+			b.distance = distance;
+			return;
 		}
-		else  
+		if (b.distance < distance)   //occupant is closer to home than the carried key, so swap them
 		{
-			Node* curr = m_hashMap[bucketNum];
-			while (curr->next != nullptr)   
-				curr = curr->next;
-			Node* insert = new Node;
-			insert->key = key;
-			insert->value = value;
-			insert->next = nullptr;
-			curr->next = insert;
+			std::swap(b.slot.key, key);
+			std::swap(b.slot.value, value);
+			std::swap(b.hash, hash);
+			std::swap(b.distance, distance);
 		}
-		m_size++;
-	}
-	else
-	{
-		ValueType* val = find(key);
-		*val = value;
+		distance++;
+		index = (index + 1) & mask;
 	}
 }
 
 template<typename KeyType, typename ValueType>
-void ExpandableHashMap<KeyType, ValueType>::expandHash()
+void ExpandableHashMap<KeyType, ValueType>::expandHash(std::size_t newCapacity)
 {
-	int newCapacity = m_capacity * 2;
-	Node** newMap = new Node * [newCapacity];
-	for (int i = 0; i < newCapacity; i++)  
-		newMap[i] = nullptr;
+	if (newCapacity > MAX_BUCKETS)   //m_shift would go negative; better to fail here than to misplace keys
+		throw std::length_error("ExpandableHashMap can't grow past 2^32 buckets with 32-bit hashes");
+	Bucket* oldMap = m_hashMap;
+	std::size_t oldCapacity = m_capacity;
+	allocateBuckets(newCapacity);
 
-	for (int i = 0; i < m_capacity; i++)   
+	for (std::size_t i = 0; i < oldCapacity; i++)   //move every association into the new array, reusing the cached hashes
 	{
-		Node* curr = m_hashMap[i];
-		while (curr != nullptr)   
+		Bucket& b = oldMap[i];
+		if (b.distance != 0)
 		{
-			KeyType copyKey = curr->key;  
-			unsigned int bucketNum = getBucket(copyKey, newCapacity);  
-
-			if (newMap[bucketNum] == nullptr)  
-			{
-				Node* insert = new Node;
-				insert->key = copyKey;
-				insert->value = curr->value;
-				insert->next = nullptr;
-				newMap[bucketNum] = insert;
-			}
-			else if (newMap[bucketNum]->key == curr->key)
-				newMap[bucketNum]->value = curr->value;
-			else 
-			{
-				Node* p = newMap[bucketNum];
-				while (p->next != nullptr)   
-					p = p->next;
-				Node* insert = new Node;
-				insert->key = copyKey;
-				insert->value = curr->value;
-				insert->next = nullptr;
-				p->next = insert;
-			}
-			curr = curr->next;
+			placeNew(b.hash, std::move(b.slot.key), std::move(b.slot.value));
+			b.slot.~Slot();
 		}
 	}
+	delete[] oldMap;
+}
 
-	clearHash();
-	m_hashMap = newMap;
-	m_capacity = newCapacity;
-	m_maxSize = (int)(m_maxLoadFactor * newCapacity);
+template<typename KeyType, typename ValueType>
+void ExpandableHashMap<KeyType, ValueType>::allocateBuckets(std::size_t capacity)
+{
+	m_hashMap = new Bucket[capacity];
+	m_capacity = capacity;
+	m_maxSize = (std::size_t)(m_maxLoadFactor * capacity);
+	m_shift = 32;
+	for (std::size_t c = capacity; c > 1; c /= 2)
+		m_shift--;
 }
 
 template<typename KeyType, typename ValueType>
-int ExpandableHashMap<KeyType, ValueType>::getBucket(const KeyType& key, const int& capacity) const
+unsigned int ExpandableHashMap<KeyType, ValueType>::getHash(const KeyType& key) const
 {
 	unsigned int hasher(const KeyType & key2);
-	unsigned int bucketNum = hasher(key);
-	return bucketNum % capacity;
+	return hasher(key);
 }
 
 template<typename KeyType, typename ValueType>
-const ValueType* ExpandableHashMap<KeyType, ValueType>::find(const KeyType& key) const
+std::size_t ExpandableHashMap<KeyType, ValueType>::getBucket(unsigned int hash) const
 {
-	int bucketNum = getBucket(key, m_capacity);
-	if (m_hashMap[bucketNum] == nullptr)  
-		return nullptr;
+	//fibonacci hashing spreads weak hashes (e.g. small integers) across the whole table
+	if (m_shift == 32)
+		return 0;
+	return (std::size_t)((hash * 2654435769u) >> m_shift);
+}
 
-	for (Node* curr = m_hashMap[bucketNum]; curr != nullptr; curr = curr->next) 
+template<typename KeyType, typename ValueType>
+bool ExpandableHashMap<KeyType, ValueType>::findIndex(const KeyType& key, unsigned int hash, std::size_t& index) const
+{
+	std::size_t mask = m_capacity - 1;
+	index = getBucket(hash);
+	for (unsigned int distance = 1; ; distance++)
 	{
-		if (curr->key == key)
-			return &(curr->value);    
+		const Bucket& b = m_hashMap[index];
+		if (b.distance < distance)   //empty, or a key closer to home than ours would be: ours isn't here
+			return false;
+		if (b.hash == hash && b.slot.key == key)
+			return true;
+		index = (index + 1) & mask;
 	}
-	return nullptr;  
+}
+
+template<typename KeyType, typename ValueType>
+const ValueType* ExpandableHashMap<KeyType, ValueType>::find(const KeyType& key) const
+{
+	std::size_t index;
+	if (!findIndex(key, getHash(key), index))
+		return nullptr;
+	return &(m_hashMap[index].slot.value);
 }
 
 template<typename KeyType, typename ValueType>
 void ExpandableHashMap<KeyType, ValueType>::clearHash()
 {
-	for (int i = 0; i < m_capacity; i++)   
+	for (std::size_t i = 0; i < m_capacity; i++)
 	{
-		Node* curr = m_hashMap[i];
-		while (curr != nullptr)
-		{
-			Node* kill = curr;
-			curr = curr->next;
-			delete kill;
-		}
+		if (m_hashMap[i].distance != 0)
+			m_hashMap[i].slot.~Slot();
 	}
 	delete[] m_hashMap;
-}
\ No newline at end of file
+}
+
+#endif // EXPANDABLEHASHMAP_INCLUDED
@@ -0,0 +1,74 @@
+#include "MappedFile.h"
+#include <fstream>
+#include <sstream>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MAPPEDFILE_USE_MMAP 1
+#endif
+using namespace std;
+
+//Gives loaders a single contiguous, read-only buffer holding an entire file
+
+MappedFile::MappedFile()
+    :m_data(""), m_size(0), m_mapped(false)
+{
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const string& path)
+{
+    close();
+#ifdef MAPPEDFILE_USE_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    if (info.st_size > 0)   //mmap can't map an empty file, which is left as an empty buffer
+    {
+        void* p = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED)
+        {
+            madvise(p, (size_t)info.st_size, MADV_SEQUENTIAL);
+            m_data = static_cast<const char*>(p);
+            m_size = (size_t)info.st_size;
+            m_mapped = true;
+        }
+    }
+    ::close(fd);   //the mapping stays valid after the descriptor is closed
+    if (m_mapped || info.st_size == 0)
+        return true;
+#endif
+    ifstream inf(path, ios::binary);  //no mmap: read the whole file instead
+    if (!inf)
+        return false;
+    ostringstream contents;
+    contents << inf.rdbuf();
+    m_buffer = contents.str();
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+    return true;
+}
+
+void MappedFile::close()
+{
+#ifdef MAPPEDFILE_USE_MMAP
+    if (m_mapped)
+        munmap(const_cast<char*>(m_data), m_size);
+#endif
+    m_data = "";
+    m_size = 0;
+    m_mapped = false;
+    m_buffer.clear();
+}
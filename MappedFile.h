@@ -0,0 +1,32 @@
+// MappedFile.h
+
+// Read-only view of a whole file.  On POSIX systems the file is memory-mapped
+// so the pages are only read in as they are touched; elsewhere it is read into
+// memory in one go.
+
+#ifndef MAPPEDFILE_INCLUDED
+#define MAPPEDFILE_INCLUDED
+
+#include <cstddef>
+#include <string>
+
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+    bool open(const std::string& path);
+    void close();
+    const char* data() const { return m_data; }
+    std::size_t size() const { return m_size; }
+    //Prevent a MappedFile object from being copied or assigned.
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+private:
+    const char* m_data;
+    std::size_t m_size;
+    bool        m_mapped;   //true if m_data is a mapping that must be unmapped, false if it points into m_buffer
+    std::string m_buffer;
+};
+
+#endif // MAPPEDFILE_INCLUDED
@@ -0,0 +1,292 @@
+#include "PlanServer.h"
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+using namespace std;
+
+//Plans deliveries for requests streamed in over stdin or a Unix socket, with the map loaded once
+
+namespace
+{
+    const size_t MAX_REQUEST_BYTES = 16 << 20;   //a longer line is taken as garbage and ends the connection
+
+    //splits what read() returns into lines, without the newline (or a \r before it)
+    class LineReader
+    {
+    public:
+        LineReader(int fd)
+            : m_fd(fd), m_start(0)
+        {}
+
+        bool next(string& line)
+        {
+            for (;;)
+            {
+                size_t newline = m_buffer.find('\n', m_start);
+                if (newline != string::npos)
+                {
+                    line.assign(m_buffer, m_start, newline - m_start);
+                    m_start = newline + 1;
+                    if (!line.empty() && line.back() == '\r')
+                        line.pop_back();
+                    return true;
+                }
+                m_buffer.erase(0, m_start);
+                m_start = 0;
+                if (m_buffer.size() > MAX_REQUEST_BYTES)
+                    return false;
+                char chunk[65536];
+                ssize_t got = read(m_fd, chunk, sizeof(chunk));
+                if (got < 0 && errno == EINTR)
+                    continue;
+                if (got <= 0)   //end of input: a last line without a newline still counts
+                {
+                    if (m_buffer.empty())
+                        return false;
+                    line.swap(m_buffer);
+                    m_buffer.clear();
+                    return true;
+                }
+                m_buffer.append(chunk, (size_t)got);
+            }
+        }
+
+    private:
+        int m_fd;
+        string m_buffer;
+        size_t m_start;   //first byte of m_buffer not yet returned
+    };
+
+    string trim(const string& s)
+    {
+        size_t first = s.find_first_not_of(" \t");
+        if (first == string::npos)
+            return "";
+        return s.substr(first, s.find_last_not_of(" \t") + 1 - first);
+    }
+}
+
+struct PlanServer::Connection
+{
+    Connection(int fd, bool closeWhenDone)
+        : outFd(fd), ownsFd(closeWhenDone), pending(0), broken(false)
+    {}
+    ~Connection()
+    {
+        if (ownsFd)
+            close(outFd);
+    }
+
+    void write(const string& text)
+    {
+        lock_guard<mutex> lock(writeMutex);
+        size_t sent = 0;
+        while (!broken && sent != text.size())
+        {
+            ssize_t n = ::write(outFd, text.data() + sent, text.size() - sent);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)   //the client has gone; its remaining answers are dropped
+                broken = true;
+            else
+                sent += (size_t)n;
+        }
+    }
+
+    int outFd;
+    bool ownsFd;
+    mutex writeMutex;
+    size_t pending;   //requests read but not yet answered, guarded by pendingMutex
+    mutex pendingMutex;
+    condition_variable allAnswered;
+    bool broken;
+};
+
+PlanServer::PlanServer(const StreetMap* sm, unsigned int workers)
+    :m_planner(sm), m_stopping(false)
+{
+    signal(SIGPIPE, SIG_IGN);   //a client that disconnects early must not kill the server; its writes just fail
+    if (workers == 0)
+        workers = thread::hardware_concurrency();
+    if (workers == 0)
+        workers = 1;
+    m_maxQueued = 4 * workers;
+    for (unsigned int i = 0; i != workers; i++)
+        m_workers.push_back(thread(&PlanServer::workerLoop, this));
+}
+
+PlanServer::~PlanServer()
+{
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_jobReady.notify_all();
+    for (size_t i = 0; i != m_workers.size(); i++)
+        m_workers[i].join();
+}
+
+void PlanServer::serveStream(int inFd, int outFd)
+{
+    shared_ptr<Connection> connection = make_shared<Connection>(outFd, false);
+    readRequests(inFd, connection);
+    unique_lock<mutex> lock(connection->pendingMutex);
+    connection->allAnswered.wait(lock, [&connection]() { return connection->pending == 0; });
+}
+
+bool PlanServer::serveSocket(const string& path)
+{
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path))
+        return false;
+    strcpy(address.sun_path, path.c_str());
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0)
+        return false;
+    unlink(path.c_str());
+    if (bind(listener, (sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 64) != 0)
+    {
+        close(listener);
+        return false;
+    }
+
+    for (;;)
+    {
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            close(listener);
+            return false;
+        }
+        //one reader thread per connection; the socket is closed once it is read to the end and every answer is written
+        shared_ptr<Connection> connection = make_shared<Connection>(fd, true);
+        thread([this, fd, connection]() { readRequests(fd, connection); }).detach();
+    }
+}
+
+void PlanServer::readRequests(int inFd, const shared_ptr<Connection>& connection)
+{
+    LineReader reader(inFd);
+    string line;
+    while (reader.next(line))
+    {
+        if (trim(line).empty())
+            continue;
+        {
+            lock_guard<mutex> lock(connection->pendingMutex);
+            connection->pending++;
+        }
+        Job job = { connection, move(line) };
+        submit(move(job));
+    }
+}
+
+void PlanServer::submit(Job&& job)
+{
+    {
+        unique_lock<mutex> lock(m_mutex);
+        m_roomReady.wait(lock, [this]() { return m_jobs.size() < m_maxQueued; });   //back pressure on the reader
+        m_jobs.push_back(move(job));
+    }
+    m_jobReady.notify_one();
+}
+
+void PlanServer::workerLoop()
+{
+    for (;;)
+    {
+        Job job;
+        {
+            unique_lock<mutex> lock(m_mutex);
+            m_jobReady.wait(lock, [this]() { return m_stopping || !m_jobs.empty(); });
+            if (m_jobs.empty())   //only reached when stopping
+                return;
+            job = move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+        m_roomReady.notify_one();
+
+        job.connection->write(answer(job.request));
+        lock_guard<mutex> lock(job.connection->pendingMutex);
+        if (--job.connection->pending == 0)
+            job.connection->allAnswered.notify_all();
+    }
+}
+
+string PlanServer::answer(const string& request) const
+{
+    string id;
+    istringstream(request) >> id;
+    if (id.empty())
+        id = "-";
+    //one request must never take down the others: whatever goes wrong planning it is only this request's error
+    try
+    {
+        return planRequest(id, request);
+    }
+    catch (const exception& e)
+    {
+        return id + " error " + e.what() + "\n";
+    }
+}
+
+string PlanServer::planRequest(const string& id, const string& request) const
+{
+    //request fields are separated by '|': the id and depot first, then one delivery each
+    vector<string> fields;
+    for (size_t start = 0; ; )
+    {
+        size_t bar = request.find('|', start);
+        fields.push_back(trim(request.substr(start, bar == string::npos ? string::npos : bar - start)));
+        if (bar == string::npos)
+            break;
+        start = bar + 1;
+    }
+
+    string skippedId;
+    string lat;
+    string lon;
+    istringstream head(fields[0]);
+    if (!(head >> skippedId >> lat >> lon))
+        return id + " error bad request: expected <id> <depot lat> <depot lon>\n";
+    if (!isValidCoordinate(lat, lon))
+        return id + " error bad request: depot is not a valid coordinate\n";
+
+    vector<DeliveryRequest> deliveries;
+    for (size_t i = 1; i != fields.size(); i++)
+    {
+        size_t colon = fields[i].find(':');
+        string itemLat;
+        string itemLon;
+        istringstream coords(fields[i].substr(0, colon));
+        if (colon == string::npos || !(coords >> itemLat >> itemLon) || colon + 1 == fields[i].size())
+            return id + " error bad request: expected <lat> <lon>:<item> in delivery " + to_string(i) + "\n";
+        if (!isValidCoordinate(itemLat, itemLon))
+            return id + " error bad request: delivery " + to_string(i) + " is not a valid coordinate\n";
+        deliveries.push_back(DeliveryRequest(fields[i].substr(colon + 1), GeoCoord(itemLat, itemLon)));
+    }
+
+    vector<DeliveryCommand> commands;
+    double miles = 0;
+    DeliveryResult result = m_planner.generateDeliveryPlan(GeoCoord(lat, lon), deliveries, commands, miles);
+    if (result == BAD_COORD)
+        return id + " error BAD_COORD\n";
+    if (result == NO_ROUTE)
+        return id + " error NO_ROUTE\n";
+
+    ostringstream out;
+    for (const DeliveryCommand& dc : commands)
+        out << id << ' ' << dc.description() << '\n';
+    out << id << " done " << fixed << setprecision(2) << miles << '\n';
+    return out.str();
+}
@@ -0,0 +1,79 @@
+// PlanServer.h
+
+// Answers delivery plan requests against one loaded StreetMap, so a long-running
+// process pays for loading the map once rather than once per plan.  Requests
+// arrive one per line, on a stream (stdin) or on connections to a Unix socket,
+// and are planned concurrently by a fixed set of worker threads; each answer is
+// written back to the stream the request came from as soon as it is ready, so
+// answers to one stream can come back in a different order than their requests.
+//
+// Request:    <id> <depot lat> <depot lon> | <lat> <lon>:<item> | <lat> <lon>:<item> ...
+// Answer:     <id> <command>       one line per DeliveryCommand, in order
+//             <id> done <miles>    after the last command
+//         or  <id> error <reason>  bad request, BAD_COORD or NO_ROUTE
+// Coordinates are decimal degrees, latitude within +/-90 and longitude within
+// +/-180; anything else is a bad request.
+// The id is any word the client likes; it is only echoed back.  Blank lines are
+// ignored.  An answer's lines are written together, never mixed with another's.
+
+#ifndef PLANSERVER_INCLUDED
+#define PLANSERVER_INCLUDED
+
+#include "provided.h"
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class PlanServer
+{
+public:
+    // workers == 0 means one per hardware thread
+    PlanServer(const StreetMap* sm, unsigned int workers = 0);
+    ~PlanServer();
+
+    // Serves the requests read from inFd until end of file, writing answers to outFd;
+    // returns once every request has been answered.  Neither descriptor is closed.
+    void serveStream(int inFd, int outFd);
+
+    // Listens on a Unix socket at path (replacing any stale socket file there) and
+    // serves every connection until the process ends.  Returns false only if the
+    // socket can't be set up.
+    bool serveSocket(const std::string& path);
+
+    // Answers one request line, as a worker does; never throws
+    std::string answer(const std::string& request) const;
+
+    //Prevent a PlanServer object from being copied or assigned.
+    PlanServer(const PlanServer&) = delete;
+    PlanServer& operator=(const PlanServer&) = delete;
+
+private:
+    struct Connection;   // where answers go, and how many requests are still being planned
+
+    struct Job
+    {
+        std::shared_ptr<Connection> connection;
+        std::string request;
+    };
+
+    void readRequests(int inFd, const std::shared_ptr<Connection>& connection);
+    void submit(Job&& job);
+    void workerLoop();
+    std::string planRequest(const std::string& id, const std::string& request) const;
+
+    DeliveryPlanner m_planner;
+    std::vector<std::thread> m_workers;
+    std::deque<Job> m_jobs;            // at most m_maxQueued, so a fast client can't queue without limit
+    std::size_t m_maxQueued;
+    std::mutex m_mutex;
+    std::condition_variable m_jobReady;
+    std::condition_variable m_roomReady;
+    bool m_stopping;
+};
+
+#endif // PLANSERVER_INCLUDED
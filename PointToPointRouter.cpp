@@ -1,12 +1,17 @@
 #include "provided.h"
-#include <queue>
-#include <list>
-#include <set>
-#include "ExpandableHashMap.h"
+#include "RouterWorkspace.h"
+#include "RouteCache.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <list>
+#include <vector>
+#include <limits>
+#include <utility>
 using namespace std;
 
-//Initializes a StreetMap object containing an expandable hash map containing coordinates and uses those coordinates to contruct a viable route from a starting coordinate to ending coordinate
+//Uses the coordinates stored in a StreetMap to construct the shortest route (in miles) from a starting coordinate to an ending coordinate
 
 class PointToPointRouterImpl
 {
@@ -16,24 +21,65 @@ public:
     DeliveryResult generatePointToPointRoute(
         const GeoCoord& start,
         const GeoCoord& end,
-        list<StreetSegment>& route,
-        double& totalDistanceTravelled) const;
+        Route& route,
+        double& totalDistanceTravelled,
+        RouteSearchStats* stats,
+        RouterWorkspace* workspace) const;
+    void generateRoutes(const vector<pair<GeoCoord, GeoCoord>>& pairs, RouteBatch& batch, bool distancesOnly) const;
+    void setSearchMode(RouteSearchMode mode);
+    void setContractionHierarchy(const ContractionHierarchy* ch);
+    void setRouteCache(RouteCache* cache);
 
 private:
-    bool getBestRoute(list<StreetSegment>& route, const GeoCoord& start, const GeoCoord& end, double& totalDistanceTravelled) const;
-    void getRouteHistory(ExpandableHashMap<GeoCoord, GeoCoord>& routeMap, list<GeoCoord>& solutionOfCoords, const GeoCoord& end, double& totalDistanceTravelled) const;
-    void rankSegs(vector<StreetSegment>& possibleSegs, const GeoCoord& end, int First, int Last) const;
-    int quickSortSegs(vector<StreetSegment>& possibleSegs, const GeoCoord& end, int low, int high) const;
-    void swapSegs(vector<StreetSegment>& possibleSegs, const int& low, const int& high) const;
+    static RouterWorkspace& threadWorkspace();
+    DeliveryResult findRoute(const GeoCoord& start, const GeoCoord& end, Route& route, double& totalDistanceTravelled,
+                             RouteSearchStats& stats, RouterWorkspace& ws) const;
+    bool useHierarchy() const;
+    bool searchAStar(NodeId start, NodeId end, double& totalDistanceTravelled, RouteSearchStats& stats, RouterWorkspace& ws) const;
+    void searchTree(NodeId start, const NodeId* targets, size_t targetCount, RouterWorkspace& ws) const;
+    void routeGroup(const vector<size_t>& pairIndexes, size_t first, size_t last, const vector<NodeId>& endNodes, RouteBatch& batch,
+                    bool distancesOnly, vector<EdgeId>& edgeBuffer, vector<size_t>& edgeStart, RouterWorkspace& ws) const;
+    void appendLabelledEdges(const RouterWorkspace& ws, NodeId start, NodeId end, vector<EdgeId>& edges) const;
+    bool getBestRoute(Route& route, NodeId start, NodeId end, double& totalDistanceTravelled, RouteSearchStats& stats, RouterWorkspace& ws) const;
+    bool getBestRouteBidirectional(Route& route, NodeId start, NodeId end, double& totalDistanceTravelled, RouteSearchStats& stats, RouterWorkspace& ws) const;
+    bool getBestRouteHierarchy(Route& route, NodeId start, NodeId end, double& totalDistanceTravelled, RouteSearchStats& stats, RouterWorkspace& ws) const;
+    EdgeId reverseEdge(NodeId from, NodeId to, EdgeId e) const;
+    void routeFromNodes(const vector<NodeId>& nodes, Route& route) const;
+    void nodesFromRoute(const Route& route, vector<NodeId>& nodes) const;
+    double crowMiles(NodeId from, NodeId to) const;
 
     const StreetMap* m_streetMap;
+    RouteSearchMode m_searchMode;
+    const ContractionHierarchy* m_hierarchy;   //used by SEARCH_CONTRACTION_HIERARCHY, may be null
+    RouteCache* m_cache;                       //consulted before searching, may be null
 };
 
 PointToPointRouterImpl::PointToPointRouterImpl(const StreetMap* sm)
-    :m_streetMap(sm)
+    :m_streetMap(sm), m_searchMode(SEARCH_UNIDIRECTIONAL), m_hierarchy(nullptr), m_cache(nullptr)
 {
 }
 
+void PointToPointRouterImpl::setSearchMode(RouteSearchMode mode)
+{
+    m_searchMode = mode;
+}
+
+void PointToPointRouterImpl::setContractionHierarchy(const ContractionHierarchy* ch)
+{
+    m_hierarchy = ch;
+}
+
+void PointToPointRouterImpl::setRouteCache(RouteCache* cache)
+{
+    m_cache = cache;
+}
+
+double PointToPointRouterImpl::crowMiles(NodeId from, NodeId to) const
+{
+    const StreetGraph& g = m_streetMap->graph();
+    return distanceEarthMiles(g.latitudes[from], g.longitudes[from], g.latitudes[to], g.longitudes[to]);
+}
+
 PointToPointRouterImpl::~PointToPointRouterImpl()
 {
 }
@@ -41,158 +87,423 @@ PointToPointRouterImpl::~PointToPointRouterImpl()
 DeliveryResult PointToPointRouterImpl::generatePointToPointRoute(
     const GeoCoord& start,
     const GeoCoord& end,
-    list<StreetSegment>& route,
-    double& totalDistanceTravelled) const
+    Route& route,
+    double& totalDistanceTravelled,
+    RouteSearchStats* stats,
+    RouterWorkspace* workspace) const
 {
-    vector<StreetSegment> startSegs;
-    vector<StreetSegment> endSegs;
+    RouteSearchStats unused;
+    RouteSearchStats& searchStats = (stats != nullptr ? *stats : unused);
+    searchStats = RouteSearchStats();
+    RouterWorkspace& ws = (workspace != nullptr ? *workspace : threadWorkspace());
+
+    //the searches count their own work; what they allocated and how long it all took is measured around them
+    chrono::steady_clock::time_point began = chrono::steady_clock::now();
+    size_t allocationsBefore = ws.allocations();
+    size_t routeCapacity = route.edges().capacity();
+    DeliveryResult result = findRoute(start, end, route, totalDistanceTravelled, searchStats, ws);
+    searchStats.allocations = ws.allocations() - allocationsBefore + (route.edges().capacity() != routeCapacity ? 1 : 0);
+    searchStats.seconds = chrono::duration<double>(chrono::steady_clock::now() - began).count();
+    return result;
+}
 
-    if (m_streetMap->getSegmentsThatStartWith(start, startSegs) == false || m_streetMap->getSegmentsThatStartWith(end, endSegs) == false)  
+DeliveryResult PointToPointRouterImpl::findRoute(const GeoCoord& start, const GeoCoord& end, Route& route, double& totalDistanceTravelled,
+                                                 RouteSearchStats& searchStats, RouterWorkspace& ws) const
+{
+    NodeId startNode;
+    NodeId endNode;
+
+    if (m_streetMap->getNodeId(CoordKey(start), startNode) == false || m_streetMap->getNodeId(CoordKey(end), endNode) == false)  
         return BAD_COORD;
     else
     {
-        while (!route.empty())   
+        route.reset(m_streetMap, startNode);
+
+        if (startNode == endNode)  
         {
-            list<StreetSegment>::iterator it = route.begin();
-            it = route.erase(it);
+            totalDistanceTravelled = 0;  
+            return DELIVERY_SUCCESS;
         }
 
-        if (start == end)  
+        vector<NodeId> cachedNodes;
+        if (m_cache != nullptr && m_cache->lookup(m_streetMap->generation(), startNode, endNode, cachedNodes, totalDistanceTravelled))
         {
-            totalDistanceTravelled = 0;  
+            if (cachedNodes.empty())
+                return NO_ROUTE;
+            routeFromNodes(cachedNodes, route);
             return DELIVERY_SUCCESS;
         }
 
-        if (getBestRoute(route, start, end, totalDistanceTravelled)) //find the best route from start to end   
+        bool found;   //find the best route from start to end
+        if (useHierarchy())
+            found = getBestRouteHierarchy(route, startNode, endNode, totalDistanceTravelled, searchStats, ws);
+        else if (m_searchMode == SEARCH_BIDIRECTIONAL)
+            found = getBestRouteBidirectional(route, startNode, endNode, totalDistanceTravelled, searchStats, ws);
+        else
+            found = getBestRoute(route, startNode, endNode, totalDistanceTravelled, searchStats, ws);
+        if (m_cache != nullptr)
+        {
+            if (found)
+                nodesFromRoute(route, cachedNodes);
+            m_cache->store(m_streetMap->generation(), startNode, endNode, cachedNodes,
+                found ? totalDistanceTravelled : numeric_limits<double>::infinity());
+        }
+        if (found)
             return DELIVERY_SUCCESS;
     }
 
     return NO_ROUTE;
 }
 
-bool PointToPointRouterImpl::getBestRoute(list<StreetSegment>& route, const GeoCoord& start, const GeoCoord& end, double& totalDistanceTravelled) const
+RouterWorkspace& PointToPointRouterImpl::threadWorkspace()
+{
+    thread_local RouterWorkspace ws;   //used when the caller doesn't supply a workspace
+    return ws;
+}
+
+bool PointToPointRouterImpl::useHierarchy() const
+{
+    return m_searchMode == SEARCH_CONTRACTION_HIERARCHY && m_hierarchy != nullptr && m_hierarchy->matches(m_streetMap);
+}
+
+bool PointToPointRouterImpl::getBestRoute(Route& route, NodeId start, NodeId end, double& totalDistanceTravelled, RouteSearchStats& stats, RouterWorkspace& ws) const
+{
+    if (!searchAStar(start, end, totalDistanceTravelled, stats, ws))
+        return false;
+    appendLabelledEdges(ws, start, end, route.edges());
+    return true;
+}
+
+bool PointToPointRouterImpl::searchAStar(NodeId start, NodeId end, double& totalDistanceTravelled, RouteSearchStats& stats, RouterWorkspace& ws) const
 {
-    ExpandableHashMap<GeoCoord, GeoCoord> routeMap; 
-    vector<StreetSegment> possibleSegs;  
-    list<GeoCoord> solutionOfCoords; 
-    set<GeoCoord> history;  
-    queue<GeoCoord> g;
-    g.push(start);
-    history.insert(start);
-    while (!g.empty())
+    //A* search: nodes are expanded in order of miles travelled so far plus the straight line distance left to the end
+    //the straight line distance never overestimates the road distance, so the first time end is popped its route is the shortest
+    const StreetGraph& g = m_streetMap->graph();
+    const double endLat = g.latitudes[end];
+    const double endLon = g.longitudes[end];
+
+    //side 0 of the workspace holds each node's shortest known distance from start and the node and edge before it
+    ws.beginSearch(g.nodeCount);
+    SearchHeap& open = ws.queue(0);
+
+    ws.setLabel(0, start, 0, NO_NODE, NO_EDGE);
+    open.push(SearchEntry(distanceEarthMiles(g.latitudes[start], g.longitudes[start], endLat, endLon), 0, start));
+    stats.heapPushes++;
+    stats.peakFrontier = 1;
+    while (!open.empty())
     {
-        GeoCoord cur = g.front();
-        g.pop();
-        if (cur == end)    
-        {
-            getRouteHistory(routeMap, solutionOfCoords, end, totalDistanceTravelled); 
+        SearchEntry cur = open.top();
+        open.pop();
+        if (cur.distanceSoFar > ws.distance(0, cur.node))   //stale entry, a shorter route to this node was already expanded
+            continue;
+        stats.nodesSettled++;
 
-            list<GeoCoord>::iterator ahead = solutionOfCoords.begin();
-            list<GeoCoord>::iterator behind = ahead;
-            ahead++;
-            while (ahead != solutionOfCoords.end())
-            {
-                GeoCoord startSeg = *behind;  //start of seg
-                GeoCoord endSeg = *ahead;  //end of seg
-                //get name of street
-                vector<StreetSegment> temp;
-                string streetName;
-                m_streetMap->getSegmentsThatStartWith(startSeg, temp);   //temp holds vector containing segments that start wiht startSeg
-                vector<StreetSegment>::iterator it = temp.begin();
-                while (it != temp.end())  //iterate through vector until correct seg is found, which we know if endSegs match
-                {
-                    if ((*it).end == endSeg)
-                    {
-                        streetName = (*it).name;  //get name of street
-                        break;
-                    }
-                    it++;
-                }
-                StreetSegment s(startSeg, endSeg, streetName);  //build street segment and add to route(list containing streetsegments that contain the correct route)
-                route.push_back(s);
-                behind = ahead;  //increment behind
-                ahead++;  //increment ahead
-            }
+        if (cur.node == end)
+        {
+            totalDistanceTravelled = cur.distanceSoFar;
             return true;
         }
 
-        m_streetMap->getSegmentsThatStartWith(cur, possibleSegs);  //get all segments with this coordinate
-        int numSegs = possibleSegs.size();   //number of segments with this coordinate
+        for (EdgeId e : g.edgesFrom(cur.node))   //every segment leaving this node
+        {
+            stats.edgesRelaxed++;
+            NodeId next = g.edgeTargets[e];
+            double distance = cur.distanceSoFar + g.edgeLengths[e];
+            if (ws.distance(0, next) <= distance)   //already have a route at least as short
+                continue;
+            ws.setLabel(0, next, distance, cur.node, e);
+            open.push(SearchEntry(distance + distanceEarthMiles(g.latitudes[next], g.longitudes[next], endLat, endLon), distance, next));
+            stats.heapPushes++;
+        }
+        stats.peakFrontier = max(stats.peakFrontier, open.size());
+    }
+    return false;
+}
+
+bool PointToPointRouterImpl::getBestRouteBidirectional(Route& route, NodeId start, NodeId end, double& totalDistanceTravelled, RouteSearchStats& stats, RouterWorkspace& ws) const
+{
+    //A* from start and from end at the same time.  Both searches use the potential
+    //p(v) = (crow(v, end) - crow(start, v)) / 2, forwards as +p and backwards as -p, which makes them two halves of
+    //one Dijkstra search on the same reduced edge lengths.  Every time a search reaches a node the other one has
+    //labelled, a complete route through that node is known; once the smallest keys left in the two queues add up
+    //to at least the best such route, no route still to be found can be shorter.  The map is symmetric (every
+    //segment is stored in both directions), so the backward search walks the same edges as the forward one.
+    const StreetGraph& g = m_streetMap->graph();
+    const double infinity = numeric_limits<double>::infinity();
 
-        if (numSegs >= 2)  //if there is only 1 seg, there's nothing to sort
-            rankSegs(possibleSegs, end, 0, numSegs - 1);   //sort segments based off distance to end GeoCoord
+    ws.beginSearch(g.nodeCount);   //side 0 searches from start, side 1 from end
+    SearchHeap* open[2] = { &ws.queue(0), &ws.queue(1) };
+    const NodeId origin[2] = { start, end };
+    const double sign[2] = { 1, -1 };
 
-        int currentSegsChecked = 0;
-        while (currentSegsChecked != numSegs)     //checking each possible coordinate I can move to from the current coordinate (cur)
-        {
-            StreetSegment s = possibleSegs[currentSegsChecked];         //right now im checking each possible coord I can move to randomly, which is what I don't wants
-            GeoCoord possible = s.end;             //possible coordinate I can move to 
+    double bestRoute = infinity;   //length of the shortest complete route found so far
+    NodeId meeting = NO_NODE;      //node that route passes through
+    for (int side = 0; side != 2; side++)
+    {
+        ws.setLabel(side, origin[side], 0, NO_NODE, NO_EDGE);
+        double potential = (crowMiles(origin[side], end) - crowMiles(start, origin[side])) / 2;
+        open[side]->push(SearchEntry(sign[side] * potential, 0, origin[side]));
+    }
+    stats.heapPushes = stats.peakFrontier = 2;
 
-            if (history.find(possible) == history.end())     //make sure I haven't visited this coordinte before
+    while (!open[0]->empty() && !open[1]->empty())
+    {
+        if (open[0]->top().estimate + open[1]->top().estimate >= bestRoute)
+            break;
+
+        int side = (open[0]->top().estimate <= open[1]->top().estimate ? 0 : 1);   //advance whichever search is behind
+        SearchEntry cur = open[side]->top();
+        open[side]->pop();
+        if (cur.distanceSoFar > ws.distance(side, cur.node))   //stale entry
+            continue;
+        stats.nodesSettled++;
+
+        for (EdgeId e : g.edgesFrom(cur.node))
+        {
+            stats.edgesRelaxed++;
+            NodeId next = g.edgeTargets[e];
+            double d = cur.distanceSoFar + g.edgeLengths[e];
+            if (ws.distance(side, next) <= d)
+                continue;
+            ws.setLabel(side, next, d, cur.node, e);
+            double throughNext = d + ws.distance(1 - side, next);
+            if (throughNext < bestRoute)   //the other search has been here too: a complete route
             {
-                g.push(possible);            //push coord onto queue
-                history.insert(possible);        //Mark that I've been to this coordinate
-                routeMap.associate(possible, cur);          //mark in history that I traveled from cur->new cur(possible0
+                bestRoute = throughNext;
+                meeting = next;
             }
-            currentSegsChecked++;
+            double potential = (crowMiles(next, end) - crowMiles(start, next)) / 2;
+            open[side]->push(SearchEntry(d + sign[side] * potential, d, next));
+            stats.heapPushes++;
         }
+        stats.peakFrontier = max(stats.peakFrontier, open[0]->size() + open[1]->size());
     }
-    return false;
+
+    if (meeting == NO_NODE)
+        return false;
+
+    //start -> meeting from the forward search, then meeting -> end by walking the backward search's parents
+    appendLabelledEdges(ws, start, meeting, route.edges());
+    for (NodeId curr = meeting; curr != end; curr = ws.previousNode(1, curr))
+    {
+        //the backward search reached curr through edge next -> curr; the route uses the same segment from curr to next
+        NodeId next = ws.previousNode(1, curr);
+        route.appendEdge(reverseEdge(next, curr, ws.previousEdge(1, curr)));
+    }
+    totalDistanceTravelled = bestRoute;
+    return true;
+}
+
+bool PointToPointRouterImpl::getBestRouteHierarchy(Route& route, NodeId start, NodeId end, double& totalDistanceTravelled, RouteSearchStats& stats, RouterWorkspace& ws) const
+{
+    //the hierarchy finds the route with its shortcuts already expanded into map edges, in order from start
+    return m_hierarchy->findRoute(start, end, route.edges(), totalDistanceTravelled, &stats, &ws);
 }
 
-void PointToPointRouterImpl::rankSegs(vector<StreetSegment>& possibleSegs, const GeoCoord& end, int First, int Last) const
+EdgeId PointToPointRouterImpl::reverseEdge(NodeId from, NodeId to, EdgeId e) const
 {
-    if (Last - First >= 1)  //can only sort 2 or more segs
+    //the edge from 'to' back to 'from' along the same segment as e: same street, same length
+    const StreetGraph& g = m_streetMap->graph();
+    for (EdgeId r : g.edgesFrom(to))
     {
-        int pivotIndex;
-        pivotIndex = quickSortSegs(possibleSegs, end, First, Last);
-        rankSegs(possibleSegs, end, First, pivotIndex - 1);    //left
-        rankSegs(possibleSegs, end, pivotIndex + 1, Last);   //right
+        if (g.edgeTargets[r] == from && g.edgeNames[r] == g.edgeNames[e] && g.edgeLengths[r] == g.edgeLengths[e])
+            return r;
     }
+    return NO_EDGE;
 }
 
-int PointToPointRouterImpl::quickSortSegs(vector<StreetSegment>& possibleSegs, const GeoCoord& end, int low, int high) const
+void PointToPointRouterImpl::generateRoutes(const vector<pair<GeoCoord, GeoCoord>>& pairs, RouteBatch& batch, bool distancesOnly) const
 {
-    //quicksort partition function
-    int pivotIndex = low;
-    GeoCoord pivot = possibleSegs[low].end;
+    size_t count = pairs.size();
+    batch.results.assign(count, BAD_COORD);
+    batch.distances.assign(count, 0);
+    batch.startNodes.assign(count, NO_NODE);
+    batch.firstEdge.assign(count + 1, 0);
+    batch.edges.clear();
 
-    do
+    //pairs on the map, grouped by start node so an origin that repeats is searched once for all its destinations
+    vector<NodeId> endNodes(count, NO_NODE);
+    vector<size_t> pairIndexes;
+    for (size_t i = 0; i != count; i++)
     {
-        while (low <= high && distanceEarthMiles(possibleSegs[low].end, end) <= distanceEarthMiles(pivot, end))
-            low++;
-        while (distanceEarthMiles(possibleSegs[high].end, end) > distanceEarthMiles(pivot, end))
-            high--;
-        if (low < high)
-            swapSegs(possibleSegs, high, low);
-    } while (low < high);
+        if (m_streetMap->getNodeId(CoordKey(pairs[i].first), batch.startNodes[i]) && m_streetMap->getNodeId(CoordKey(pairs[i].second), endNodes[i]))
+            pairIndexes.push_back(i);
+        else
+            batch.startNodes[i] = NO_NODE;
+    }
+    sort(pairIndexes.begin(), pairIndexes.end(), [&](size_t a, size_t b) {
+        return batch.startNodes[a] != batch.startNodes[b] ? batch.startNodes[a] < batch.startNodes[b] : a < b;
+    });
+    vector<size_t> groupStart;
+    for (size_t k = 0; k != pairIndexes.size(); k++)
+    {
+        if (k == 0 || batch.startNodes[pairIndexes[k]] != batch.startNodes[pairIndexes[k - 1]])
+            groupStart.push_back(k);
+    }
+    groupStart.push_back(pairIndexes.size());
+    size_t groups = groupStart.size() - 1;
 
-    swapSegs(possibleSegs, pivotIndex, high);
-    pivotIndex = high;
-    return pivotIndex;
+    //each pool task takes the next group not yet routed and appends routes to its own edge buffer; edgeStart records
+    //where each pair's route begins in its task's buffer, and the buffers are joined in pair order at the end
+    ThreadPool& pool = ThreadPool::shared();
+    size_t tasks = min((size_t)pool.size(), groups);
+    vector<vector<EdgeId>> edgeBuffers(tasks);
+    vector<size_t> edgeTask(count, 0);
+    vector<size_t> edgeStart(count, 0);
+    atomic<size_t> nextGroup(0);
+    pool.parallelFor(tasks, [&](size_t task) {
+        RouterWorkspace& ws = threadWorkspace();
+        for (size_t group = nextGroup++; group < groups; group = nextGroup++)
+        {
+            routeGroup(pairIndexes, groupStart[group], groupStart[group + 1], endNodes, batch, distancesOnly, edgeBuffers[task], edgeStart, ws);
+            for (size_t k = groupStart[group]; k != groupStart[group + 1]; k++)
+                edgeTask[pairIndexes[k]] = task;
+        }
+    });
+    if (distancesOnly)
+        return;
+
+    for (size_t i = 0; i != count; i++)
+        batch.firstEdge[i + 1] += batch.firstEdge[i];   //edge counts become offsets
+    batch.edges.resize(batch.firstEdge[count]);
+    for (size_t i = 0; i != count; i++)
+    {
+        if (batch.results[i] != DELIVERY_SUCCESS)
+            continue;
+        const vector<EdgeId>& buffer = edgeBuffers[edgeTask[i]];
+        copy(buffer.begin() + edgeStart[i], buffer.begin() + edgeStart[i] + (batch.firstEdge[i + 1] - batch.firstEdge[i]), batch.edges.begin() + batch.firstEdge[i]);
+    }
+}
+
+void PointToPointRouterImpl::routeGroup(const vector<size_t>& pairIndexes, size_t first, size_t last, const vector<NodeId>& endNodes, RouteBatch& batch,
+                                        bool distancesOnly, vector<EdgeId>& edgeBuffer, vector<size_t>& edgeStart, RouterWorkspace& ws) const
+{
+    //routes pairs pairIndexes[first .. last - 1], which share a start node.  Until generateRoutes joins the buffers,
+    //batch.firstEdge[i + 1] holds the number of edges in pair i's route
+    NodeId start = batch.startNodes[pairIndexes[first]];
+    bool sharedTree = (last - first > 1 && !useHierarchy());
+    if (sharedTree)
+    {
+        vector<EdgeId>& targets = ws.routeEdges();   //scratch: the destination nodes
+        targets.clear();
+        for (size_t k = first; k != last; k++)
+            targets.push_back(endNodes[pairIndexes[k]]);
+        searchTree(start, targets.data(), targets.size(), ws);
+    }
+
+    for (size_t k = first; k != last; k++)
+    {
+        size_t i = pairIndexes[k];
+        NodeId end = endNodes[i];
+        RouteSearchStats stats;
+        bool found;
+        edgeStart[i] = edgeBuffer.size();
+        if (start == end)
+        {
+            batch.distances[i] = 0;
+            found = true;
+        }
+        else if (sharedTree)
+        {
+            batch.distances[i] = ws.distance(0, end);
+            found = (batch.distances[i] != numeric_limits<double>::infinity());
+            if (found && !distancesOnly)
+                appendLabelledEdges(ws, start, end, edgeBuffer);
+        }
+        else if (useHierarchy())
+        {
+            vector<EdgeId>& edges = ws.routeEdges();
+            found = m_hierarchy->findRoute(start, end, edges, batch.distances[i], &stats, &ws);
+            if (found && !distancesOnly)
+                edgeBuffer.insert(edgeBuffer.end(), edges.begin(), edges.end());
+        }
+        else
+        {
+            found = searchAStar(start, end, batch.distances[i], stats, ws);
+            if (found && !distancesOnly)
+                appendLabelledEdges(ws, start, end, edgeBuffer);
+        }
+        batch.results[i] = (found ? DELIVERY_SUCCESS : NO_ROUTE);
+        if (!found)
+            batch.distances[i] = 0;
+        batch.firstEdge[i + 1] = (uint32_t)(edgeBuffer.size() - edgeStart[i]);
+    }
 }
 
-void PointToPointRouterImpl::swapSegs(vector<StreetSegment>& possibleSegs, const int& low, const int& high) const
+void PointToPointRouterImpl::searchTree(NodeId start, const NodeId* targets, size_t targetCount, RouterWorkspace& ws) const
 {
-    StreetSegment temp = possibleSegs[high];
-    possibleSegs[high] = possibleSegs[low];
-    possibleSegs[low] = temp;
+    //Dijkstra from start until every target is settled, leaving the shortest route tree in side 0 of the workspace.
+    //Side 1 marks the targets not yet settled: a finite side 1 distance means "still wanted"
+    const StreetGraph& g = m_streetMap->graph();
+    ws.beginSearch(g.nodeCount);
+    size_t targetsLeft = 0;
+    for (size_t t = 0; t != targetCount; t++)
+    {
+        if (ws.distance(1, targets[t]) != 0)
+        {
+            ws.setLabel(1, targets[t], 0, NO_NODE, NO_EDGE);
+            targetsLeft++;
+        }
+    }
+
+    SearchHeap& open = ws.queue(0);
+    ws.setLabel(0, start, 0, NO_NODE, NO_EDGE);
+    open.push(SearchEntry(0, 0, start));
+    while (!open.empty() && targetsLeft != 0)
+    {
+        SearchEntry cur = open.top();
+        open.pop();
+        if (cur.distanceSoFar > ws.distance(0, cur.node))   //stale entry
+            continue;
+        if (ws.distance(1, cur.node) == 0)
+        {
+            ws.setLabel(1, cur.node, numeric_limits<double>::infinity(), NO_NODE, NO_EDGE);
+            targetsLeft--;
+        }
+        for (EdgeId e : g.edgesFrom(cur.node))
+        {
+            NodeId next = g.edgeTargets[e];
+            double d = cur.distanceSoFar + g.edgeLengths[e];
+            if (ws.distance(0, next) <= d)
+                continue;
+            ws.setLabel(0, next, d, cur.node, e);
+            open.push(SearchEntry(d, d, next));
+        }
+    }
 }
 
-void PointToPointRouterImpl::getRouteHistory(ExpandableHashMap<GeoCoord, GeoCoord>& routeMap, list<GeoCoord>& solutionOfCoords, const GeoCoord& end, double& totalDistanceTravelled) const
+void PointToPointRouterImpl::appendLabelledEdges(const RouterWorkspace& ws, NodeId start, NodeId end, vector<EdgeId>& edges) const
 {
-    const GeoCoord* curr = &end;
+    //walks side 0's labels back from end, then puts that stretch of edges into travel order
+    size_t first = edges.size();
+    for (NodeId curr = end; curr != start; curr = ws.previousNode(0, curr))
+        edges.push_back(ws.previousEdge(0, curr));
+    reverse(edges.begin() + first, edges.end());
+}
 
-    while (curr != nullptr)   //while not at start
+void PointToPointRouterImpl::routeFromNodes(const vector<NodeId>& nodes, Route& route) const
+{
+    //between two nodes take the first of the shortest edges joining them, the one a search would have relaxed first
+    const StreetGraph& g = m_streetMap->graph();
+    for (size_t i = 0; i + 1 < nodes.size(); i++)
     {
-        solutionOfCoords.push_front(*curr);
-        const GeoCoord* prev = curr;
-        curr = routeMap.find(*curr);
-        if (curr != nullptr)
-            totalDistanceTravelled += distanceEarthMiles(*curr, *prev);  //update total distance travelled
+        EdgeId best = NO_EDGE;
+        for (EdgeId e : g.edgesFrom(nodes[i]))
+        {
+            if (g.edgeTargets[e] == nodes[i + 1] && (best == NO_EDGE || g.edgeLengths[e] < g.edgeLengths[best]))
+                best = e;
+        }
+        route.appendEdge(best);
     }
 }
 
+void PointToPointRouterImpl::nodesFromRoute(const Route& route, vector<NodeId>& nodes) const
+{
+    const StreetGraph& g = m_streetMap->graph();
+    nodes.assign(1, route.startNode());
+    for (EdgeId e : route.edges())
+        nodes.push_back(g.edgeTargets[e]);
+}
 
 //******************** PointToPointRouter functions ***************************
 
@@ -209,11 +520,67 @@ PointToPointRouter::~PointToPointRouter()
     delete m_impl;
 }
 
+DeliveryResult PointToPointRouter::generatePointToPointRoute(
+    const GeoCoord& start,
+    const GeoCoord& end,
+    Route& route,
+    double& totalDistanceTravelled,
+    RouteSearchStats* stats,
+    RouterWorkspace* workspace) const
+{
+    return m_impl->generatePointToPointRoute(start, end, route, totalDistanceTravelled, stats, workspace);
+}
+
 DeliveryResult PointToPointRouter::generatePointToPointRoute(
     const GeoCoord& start,
     const GeoCoord& end,
     list<StreetSegment>& route,
-    double& totalDistanceTravelled) const
+    double& totalDistanceTravelled,
+    RouteSearchStats* stats,
+    RouterWorkspace* workspace) const
+{
+    Route compact;
+    DeliveryResult result = m_impl->generatePointToPointRoute(start, end, compact, totalDistanceTravelled, stats, workspace);
+    if (result != BAD_COORD)   //as before, a bad coordinate leaves route alone
+        compact.toList(route);
+    return result;
+}
+
+void PointToPointRouter::setSearchMode(RouteSearchMode mode)
+{
+    m_impl->setSearchMode(mode);
+}
+
+void PointToPointRouter::setContractionHierarchy(const ContractionHierarchy* ch)
+{
+    m_impl->setContractionHierarchy(ch);
+}
+
+void PointToPointRouter::setRouteCache(RouteCache* cache)
+{
+    m_impl->setRouteCache(cache);
+}
+
+void PointToPointRouter::generateRoutes(const vector<pair<GeoCoord, GeoCoord>>& pairs, RouteBatch& batch, bool distancesOnly) const
+{
+    m_impl->generateRoutes(pairs, batch, distancesOnly);
+}
+
+//******************** RouteBatch functions ***********************************
+
+void RouteBatch::getRoute(size_t i, const StreetMap& sm, Route& route) const
+{
+    route.reset(&sm, startNodes[i]);
+    route.edges().assign(edges.begin() + firstEdge[i], edges.begin() + firstEdge[i + 1]);
+}
+
+void RouteBatch::getRoute(size_t i, const StreetMap& sm, list<StreetSegment>& route) const
 {
-    return m_impl->generatePointToPointRoute(start, end, route, totalDistanceTravelled);
+    route.clear();
+    NodeId curr = startNodes[i];
+    for (uint32_t k = firstEdge[i]; k != firstEdge[i + 1]; k++)
+    {
+        route.push_back(sm.getSegment(curr, edges[k]));
+        curr = sm.graph().edgeTargets[edges[k]];
+    }
 }
@@ -0,0 +1,103 @@
+#include "RouteCache.h"
+using namespace std;
+
+RouteCache::RouteCache(size_t maxBytes)
+    :m_maxBytes(maxBytes), m_bytesUsed(0), m_hits(0), m_misses(0), m_generation(0)
+{
+}
+
+size_t RouteCache::entryBytes(const Entry& e)
+{
+    //the list node with its two links, the route's nodes, and a hash bucket for the index (counted twice, as the
+    //index runs at most half full)
+    return sizeof(Entry) + 2 * sizeof(void*) + e.nodes.capacity() * sizeof(NodeId)
+         + 2 * (sizeof(NodePairKey) + sizeof(list<Entry>::iterator) + sizeof(unsigned int));
+}
+
+void RouteCache::useGeneration(uint64_t generation)
+{
+    if (generation == m_generation)
+        return;
+    m_entries.clear();
+    m_index.reset();
+    m_bytesUsed = 0;
+    m_generation = generation;
+}
+
+void RouteCache::removeOldest()
+{
+    m_bytesUsed -= entryBytes(m_entries.back());
+    m_index.erase(m_entries.back().key);
+    m_entries.pop_back();
+}
+
+bool RouteCache::lookup(uint64_t generation, NodeId start, NodeId end, vector<NodeId>& nodes, double& distance)
+{
+    lock_guard<mutex> lock(m_mutex);
+    useGeneration(generation);
+    list<Entry>::iterator* found = m_index.find(NodePairKey(start, end));
+    if (found == nullptr)
+    {
+        m_misses++;
+        return false;
+    }
+    m_entries.splice(m_entries.begin(), m_entries, *found);   //now the most recently used
+    nodes = (*found)->nodes;
+    distance = (*found)->distance;
+    m_hits++;
+    return true;
+}
+
+void RouteCache::store(uint64_t generation, NodeId start, NodeId end, const vector<NodeId>& nodes, double distance)
+{
+    Entry entry = { NodePairKey(start, end), distance, nodes };   //copy the route before taking the lock
+    size_t bytes = entryBytes(entry);
+    if (bytes > m_maxBytes)
+        return;
+
+    lock_guard<mutex> lock(m_mutex);
+    useGeneration(generation);
+    list<Entry>::iterator* found = m_index.find(entry.key);
+    if (found != nullptr)   //another thread got there first
+    {
+        m_entries.splice(m_entries.begin(), m_entries, *found);
+        return;
+    }
+    while (m_bytesUsed + bytes > m_maxBytes)
+        removeOldest();
+    m_entries.push_front(move(entry));
+    m_index.associate(m_entries.front().key, m_entries.begin());
+    m_bytesUsed += bytes;
+}
+
+void RouteCache::clear()
+{
+    lock_guard<mutex> lock(m_mutex);
+    m_entries.clear();
+    m_index.reset();
+    m_bytesUsed = 0;
+}
+
+size_t RouteCache::hits() const
+{
+    lock_guard<mutex> lock(m_mutex);
+    return m_hits;
+}
+
+size_t RouteCache::misses() const
+{
+    lock_guard<mutex> lock(m_mutex);
+    return m_misses;
+}
+
+size_t RouteCache::size() const
+{
+    lock_guard<mutex> lock(m_mutex);
+    return m_entries.size();
+}
+
+size_t RouteCache::bytesUsed() const
+{
+    lock_guard<mutex> lock(m_mutex);
+    return m_bytesUsed;
+}
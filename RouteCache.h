@@ -0,0 +1,83 @@
+// RouteCache.h
+
+// Memory-bounded cache of the routes PointToPointRouter finds, keyed by start
+// and end node.  A route is kept as the nodes it passes through (4 bytes a node)
+// plus its length, and pairs with no route are remembered too.  When the
+// estimated size goes over the limit, the least recently used routes are dropped.
+// Entries belong to one load of a map: the first lookup or store with a
+// different StreetMap::generation() empties the cache, so reloading the map
+// invalidates it without anyone having to say so.  Safe to share between threads.
+
+#ifndef ROUTECACHE_INCLUDED
+#define ROUTECACHE_INCLUDED
+
+#include "provided.h"
+#include "ExpandableHashMap.h"
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <vector>
+
+// The start and end node of a route, the key routes are cached under
+struct NodePairKey
+{
+    NodePairKey(NodeId start = 0, NodeId end = 0)
+        : bits((std::uint64_t)start << 32 | end)
+    {}
+
+    bool operator==(const NodePairKey& other) const { return bits == other.bits; }
+
+    std::uint64_t bits;   // start node in the high half, end node in the low
+};
+
+inline unsigned int hasher(const NodePairKey& key)
+{
+    // mix both node ids into every bit, so pairs sharing a start don't crowd together
+    std::uint64_t h = key.bits * 0x9E3779B97F4A7C15ULL;
+    return (unsigned int)(h >> 32);
+}
+
+class RouteCache
+{
+public:
+    explicit RouteCache(std::size_t maxBytes = 16 << 20);
+
+    // True if the pair is cached; nodes then runs from start to end (empty if there
+    // is no route, when distance is infinity)
+    bool lookup(std::uint64_t generation, NodeId start, NodeId end, std::vector<NodeId>& nodes, double& distance);
+    void store(std::uint64_t generation, NodeId start, NodeId end, const std::vector<NodeId>& nodes, double distance);
+    void clear();
+
+    std::size_t hits() const;
+    std::size_t misses() const;
+    std::size_t size() const;        // routes cached
+    std::size_t bytesUsed() const;   // estimate, including bookkeeping
+
+    //Prevent a RouteCache object from being copied or assigned.
+    RouteCache(const RouteCache&) = delete;
+    RouteCache& operator=(const RouteCache&) = delete;
+
+private:
+    struct Entry
+    {
+        NodePairKey key;
+        double distance;
+        std::vector<NodeId> nodes;
+    };
+
+    static std::size_t entryBytes(const Entry& e);
+    void useGeneration(std::uint64_t generation);   // the caller holds m_mutex
+    void removeOldest();                            // the caller holds m_mutex
+
+    mutable std::mutex m_mutex;
+    std::list<Entry> m_entries;   // most recently used first
+    ExpandableHashMap<NodePairKey, std::list<Entry>::iterator> m_index;
+    std::size_t m_maxBytes;
+    std::size_t m_bytesUsed;
+    std::size_t m_hits;
+    std::size_t m_misses;
+    std::uint64_t m_generation;   // of the map the entries came from
+};
+
+#endif // ROUTECACHE_INCLUDED
@@ -0,0 +1,30 @@
+#include "RouterWorkspace.h"
+using namespace std;
+
+RouterWorkspace::RouterWorkspace()
+    :m_search(1), m_labelGrowths(0)
+{
+}
+
+void RouterWorkspace::beginSearch(size_t nodeCount, int sides)
+{
+    m_search++;
+    bool wrapped = (m_search == 0);
+    if (wrapped)   //after 2^32 searches the oldest labels could look current again, so really clear them
+        m_search = 1;
+    for (int side = 0; side != SIDES; side++)
+    {
+        if (wrapped)
+        {
+            for (size_t i = 0; i != m_labels[side].size(); i++)
+                m_labels[side][i].search = 0;
+        }
+        if (side < sides && m_labels[side].size() < nodeCount)
+        {
+            Label unreached = { 0, NO_NODE, NO_EDGE, 0 };
+            m_labelGrowths++;
+            m_labels[side].resize(nodeCount, unreached);
+        }
+        m_queues[side].clear();
+    }
+}
@@ -0,0 +1,123 @@
+// RouterWorkspace.h
+
+// Per-node search state for route queries, kept between queries so a search
+// allocates nothing once the workspace has grown to the map's size.  Every label
+// carries the number of the search that wrote it, so starting a new search just
+// bumps that number instead of clearing the arrays; labels from older searches
+// read as unreached.  A workspace serves one query at a time: give each thread
+// its own.
+
+#ifndef ROUTERWORKSPACE_INCLUDED
+#define ROUTERWORKSPACE_INCLUDED
+
+#include "provided.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <utility>
+#include <vector>
+
+struct SearchEntry
+{
+    SearchEntry(double e, double d, NodeId n)
+        : estimate(e), distanceSoFar(d), node(n)
+    {}
+    bool operator>(const SearchEntry& other) const { return estimate > other.estimate; }
+
+    double estimate;        // key the queue is ordered by
+    double distanceSoFar;   // distance travelled from the search's origin to node
+    NodeId node;
+};
+
+// Binary min-heap of SearchEntry that keeps its storage when cleared
+class SearchHeap
+{
+public:
+    SearchHeap() : m_growths(0) {}
+    bool empty() const { return m_entries.empty(); }
+    std::size_t size() const { return m_entries.size(); }
+    const SearchEntry& top() const { return m_entries.front(); }
+    void push(const SearchEntry& entry)
+    {
+        if (m_entries.size() == m_entries.capacity())
+            m_growths++;
+        m_entries.push_back(entry);
+        std::push_heap(m_entries.begin(), m_entries.end(), std::greater<SearchEntry>());
+    }
+    void pop()
+    {
+        std::pop_heap(m_entries.begin(), m_entries.end(), std::greater<SearchEntry>());
+        m_entries.pop_back();
+    }
+    void clear() { m_entries.clear(); }
+    std::size_t growths() const { return m_growths; }   // times push had to reallocate, ever
+private:
+    std::vector<SearchEntry> m_entries;
+    std::size_t m_growths;
+};
+
+class RouterWorkspace
+{
+public:
+    static const int SIDES = 2;   // forward and backward halves of a bidirectional search
+
+    RouterWorkspace();
+
+    // Forgets the previous search and makes room for a map of nodeCount nodes on
+    // the first 'sides' sides (a one-sided search needn't size the other).
+    // O(1) unless the workspace has to grow.
+    void beginSearch(std::size_t nodeCount, int sides = SIDES);
+
+    double distance(int side, NodeId n) const
+    {
+        const Label& l = m_labels[side][n];
+        return l.search == m_search ? l.distance : std::numeric_limits<double>::infinity();
+    }
+    NodeId previousNode(int side, NodeId n) const { return m_labels[side][n].previousNode; }
+    EdgeId previousEdge(int side, NodeId n) const { return m_labels[side][n].previousEdge; }
+    void setLabel(int side, NodeId n, double distance, NodeId previousNode, EdgeId previousEdge)
+    {
+        Label& l = m_labels[side][n];
+        l.distance = distance;
+        l.previousNode = previousNode;
+        l.previousEdge = previousEdge;
+        l.search = m_search;
+    }
+
+    SearchHeap& queue(int side) { return m_queues[side]; }
+
+    // Times the labels or queues have had to grow since the workspace was made;
+    // the difference across a query is what that query allocated
+    std::size_t allocations() const
+    {
+        return m_labelGrowths + m_queues[0].growths() + m_queues[1].growths();
+    }
+
+    // scratch for turning a found route into map edges
+    std::vector<EdgeId>& routeEdges() { return m_routeEdges; }
+    std::vector<std::pair<std::uint32_t, NodeId>>& unpackStack() { return m_unpackStack; }
+
+    //Prevent a RouterWorkspace object from being copied or assigned.
+    RouterWorkspace(const RouterWorkspace&) = delete;
+    RouterWorkspace& operator=(const RouterWorkspace&) = delete;
+
+private:
+    struct Label
+    {
+        double        distance;
+        NodeId        previousNode;
+        EdgeId        previousEdge;
+        std::uint32_t search;   // label is only valid while this equals m_search
+    };
+
+    std::vector<Label> m_labels[SIDES];
+    SearchHeap m_queues[SIDES];
+    std::vector<EdgeId> m_routeEdges;
+    std::vector<std::pair<std::uint32_t, NodeId>> m_unpackStack;
+    std::uint32_t m_search;   // number of the current search, never 0
+    std::size_t m_labelGrowths;
+};
+
+#endif // ROUTERWORKSPACE_INCLUDED
@@ -0,0 +1,162 @@
+#include "SegmentGrid.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+using namespace std;
+
+SegmentGrid::SegmentGrid()
+{
+    clear();
+}
+
+void SegmentGrid::clear()
+{
+    m_minX = m_minY = 0;
+    m_cellSize = 1;
+    m_lonScale = 1;
+    m_cols = m_rows = 0;
+    m_cellFirst.assign(1, 0);
+    m_entries.clear();
+}
+
+void SegmentGrid::cellOf(double x, double y, int& col, int& row) const
+{
+    //points off the grid belong to the nearest edge cell
+    col = (int)max(0.0, min((double)(m_cols - 1), floor((x - m_minX) / m_cellSize)));
+    row = (int)max(0.0, min((double)(m_rows - 1), floor((y - m_minY) / m_cellSize)));
+}
+
+void SegmentGrid::build(const StreetGraph& g)
+{
+    clear();
+    if (g.nodeCount == 0)
+        return;
+
+    double minLat = g.latitudes[0], maxLat = minLat, minLon = g.longitudes[0], maxLon = minLon;
+    for (NodeId n = 1; n != g.nodeCount; n++)
+    {
+        minLat = min(minLat, g.latitudes[n]);
+        maxLat = max(maxLat, g.latitudes[n]);
+        minLon = min(minLon, g.longitudes[n]);
+        maxLon = max(maxLon, g.longitudes[n]);
+    }
+    m_lonScale = cos(deg2rad((minLat + maxLat) / 2));
+    m_minX = minLon * m_lonScale;
+    m_minY = minLat;
+    double width = (maxLon - minLon) * m_lonScale;
+    double height = maxLat - minLat;
+
+    //each segment is stored in both directions; index it once, from its lower numbered end
+    vector<Entry> segments;
+    for (NodeId n = 0; n != g.nodeCount; n++)
+    {
+        for (EdgeId e : g.edgesFrom(n))
+        {
+            if (n < g.edgeTargets[e])
+            {
+                Entry entry = { n, e };
+                segments.push_back(entry);
+            }
+        }
+    }
+
+    //about two segments per cell
+    double cells = max(1.0, segments.size() / 2.0);
+    m_cellSize = sqrt(width * height / cells);
+    if (!(m_cellSize > 0))   //all nodes on one line or one point
+        m_cellSize = max(max(width, height) / cells, 1e-6);
+    m_cols = (int)min(floor(width / m_cellSize) + 1, 4 * cells);
+    m_rows = (int)min(floor(height / m_cellSize) + 1, 4 * cells);
+
+    //two passes over the segments' bounding boxes: count the entries of each cell, then fill them in
+    m_cellFirst.assign((size_t)m_cols * m_rows + 1, 0);
+    for (int pass = 0; pass != 2; pass++)
+    {
+        vector<uint32_t> next;
+        if (pass == 1)
+        {
+            for (size_t c = 0; c + 1 < m_cellFirst.size(); c++)
+                m_cellFirst[c + 1] += m_cellFirst[c];
+            m_entries.resize(m_cellFirst.back());
+            next.assign(m_cellFirst.begin(), m_cellFirst.end() - 1);
+        }
+        for (size_t s = 0; s != segments.size(); s++)
+        {
+            NodeId a = segments[s].from, b = g.edgeTargets[segments[s].edge];
+            int col1, row1, col2, row2;
+            cellOf(g.longitudes[a] * m_lonScale, g.latitudes[a], col1, row1);
+            cellOf(g.longitudes[b] * m_lonScale, g.latitudes[b], col2, row2);
+            for (int row = min(row1, row2); row <= max(row1, row2); row++)
+            {
+                for (int col = min(col1, col2); col <= max(col1, col2); col++)
+                {
+                    size_t cell = (size_t)row * m_cols + col;
+                    if (pass == 0)
+                        m_cellFirst[cell + 1]++;
+                    else
+                        m_entries[next[cell]++] = segments[s];
+                }
+            }
+        }
+    }
+}
+
+bool SegmentGrid::nearest(const StreetGraph& g, double latitude, double longitude, NodeId& from, EdgeId& edge, double& fraction) const
+{
+    if (m_entries.empty())
+        return false;
+
+    double x = longitude * m_lonScale, y = latitude;
+    int col0, row0;
+    cellOf(x, y, col0, row0);
+    double bestSquared = numeric_limits<double>::infinity();
+
+    for (int r = 0; ; r++)
+    {
+        //cells on the border of the square of cells within r of the starting cell
+        for (int row = row0 - r; row <= row0 + r; row++)
+        {
+            if (row < 0 || row >= m_rows)
+                continue;
+            int step = (row == row0 - r || row == row0 + r) ? 1 : 2 * r;   //whole top and bottom rows, only the sides between
+            for (int col = col0 - r; col <= col0 + r; col += step)
+            {
+                if (col < 0 || col >= m_cols)
+                    continue;
+                size_t cell = (size_t)row * m_cols + col;
+                for (uint32_t i = m_cellFirst[cell]; i != m_cellFirst[cell + 1]; i++)
+                {
+                    NodeId a = m_entries[i].from, b = g.edgeTargets[m_entries[i].edge];
+                    double ax = g.longitudes[a] * m_lonScale, ay = g.latitudes[a];
+                    double dx = g.longitudes[b] * m_lonScale - ax, dy = g.latitudes[b] - ay;
+                    double lengthSquared = dx * dx + dy * dy;
+                    double t = (lengthSquared > 0 ? ((x - ax) * dx + (y - ay) * dy) / lengthSquared : 0);
+                    t = max(0.0, min(1.0, t));
+                    double px = ax + t * dx - x, py = ay + t * dy - y;
+                    double squared = px * px + py * py;
+                    if (squared < bestSquared)
+                    {
+                        bestSquared = squared;
+                        from = a;
+                        edge = m_entries[i].edge;
+                        fraction = t;
+                    }
+                }
+            }
+        }
+
+        //stop once the whole grid has been searched, or nothing outside the searched square can be closer
+        double gap = numeric_limits<double>::infinity();
+        if (col0 - r > 0)
+            gap = min(gap, x - (m_minX + (col0 - r) * m_cellSize));
+        if (col0 + r < m_cols - 1)
+            gap = min(gap, m_minX + (col0 + r + 1) * m_cellSize - x);
+        if (row0 - r > 0)
+            gap = min(gap, y - (m_minY + (row0 - r) * m_cellSize));
+        if (row0 + r < m_rows - 1)
+            gap = min(gap, m_minY + (row0 + r + 1) * m_cellSize - y);
+        if (gap == numeric_limits<double>::infinity() || (gap > 0 && gap * gap >= bestSquared))
+            break;
+    }
+    return true;
+}
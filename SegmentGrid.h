@@ -0,0 +1,49 @@
+// SegmentGrid.h
+
+// Uniform grid over the street segments of a StreetGraph, for finding the
+// segment closest to an arbitrary coordinate.  Each cell lists every segment
+// whose bounding box touches it; a query checks the cells in square rings
+// around the coordinate's cell until no unchecked cell can hold anything closer.
+// Distances are measured in a flat projection around the middle of the map
+// (longitude scaled by the cosine of the latitude), which is accurate to well
+// under a metre over a city.
+
+#ifndef SEGMENTGRID_INCLUDED
+#define SEGMENTGRID_INCLUDED
+
+#include "provided.h"
+#include <cstdint>
+#include <vector>
+
+class SegmentGrid
+{
+public:
+    SegmentGrid();
+    void build(const StreetGraph& g);
+    void clear();
+
+    // Closest point to (latitude, longitude) on any segment: the segment from
+    // node 'from' along edge 'edge', at 'fraction' (0 = from, 1 = the other end)
+    // of its length.  Returns false if the graph has no segments.
+    bool nearest(const StreetGraph& g, double latitude, double longitude, NodeId& from, EdgeId& edge, double& fraction) const;
+
+private:
+    struct Entry
+    {
+        NodeId from;
+        EdgeId edge;
+    };
+
+    void cellOf(double x, double y, int& col, int& row) const;
+
+    double m_minX;        // west edge of the grid, in scaled longitude degrees
+    double m_minY;        // south edge of the grid, in latitude degrees
+    double m_cellSize;    // side of a cell, in latitude degrees
+    double m_lonScale;    // cosine of the grid's middle latitude
+    int m_cols;
+    int m_rows;
+    std::vector<std::uint32_t> m_cellFirst;   // entries of cell row * m_cols + col are m_cellFirst[c] .. m_cellFirst[c + 1] - 1
+    std::vector<Entry> m_entries;
+};
+
+#endif // SEGMENTGRID_INCLUDED
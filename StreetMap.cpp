@@ -1,22 +1,44 @@
 #include "provided.h"
 #include <iostream>
 #include <fstream>
-#include <sstream>
-#include <string>
 #include <string>
 #include <vector>
+#include <algorithm>
+#include <atomic>
 #include <functional>
+#include <chrono>
 #include <cctype>
+#include <cmath>
+#include <cstring>
+#include <mutex>
 #include "ExpandableHashMap.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
+#include "SegmentGrid.h"
+#include "Checksum.h"
 using namespace std;
 
-//Loads text file of GeoCoords into an expandable hash map
+//Loads text file of GeoCoords into a compact street graph, indexed by an expandable hash map
+
+unsigned int hasher(const CoordKey& k)
+{
+    //64-bit finalizer from MurmurHash3: every input bit affects every output bit
+    uint64_t x = k.bits;
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return (unsigned int)x;
+}
 
-unsigned int hasher(const GeoCoord& g)
+unsigned int hasher(const string& s)
 {
-    return std::hash<string>()(g.latitudeText + g.longitudeText);
+    return std::hash<string>()(s);
 }
 
+static atomic<uint64_t> nextGeneration(1);   //shared by every StreetMap, so no two loads anywhere get the same number
+
 class StreetMapImpl
 {
 public:
@@ -24,112 +46,756 @@ public:
     ~StreetMapImpl();
     bool load(string mapFile);
     bool getSegmentsThatStartWith(const GeoCoord& gc, vector<StreetSegment>& segs) const;
+    const StreetGraph& graph() const;
+    bool getNodeId(const GeoCoord& gc, NodeId& id) const;
+    bool getNodeId(const CoordKey& key, NodeId& id) const;
+    CoordKey getNodeKey(NodeId id) const;
+    GeoCoord getNodeCoord(NodeId id) const;
+    bool getEdgesThatStartWith(const GeoCoord& gc, NodeId& from, EdgeRange& edges) const;
+    StreetSegment getSegment(NodeId from, EdgeId e) const;
+    bool snapToSegment(const GeoCoord& gc, SnappedPoint& snapped) const;
+    MapLoadStats getLoadStats() const;
+    uint64_t generation() const;
+    bool saveBinary(string binaryFile) const;
+    bool loadBinary(string binaryFile);
 
 private:
-    bool isStreetName(string line);
-    void insertInHashMap(const GeoCoord& coord, StreetSegment seg);
+    struct RawEdge   //one direction of a segment, collected while reading before being packed into the graph
+    {
+        NodeId from;
+        NodeId to;
+        NameId name;
+        double length;
+    };
+
+    struct ParsedChunk   //streets read by one thread, with nodes and names numbered locally in order of appearance
+    {
+        vector<CoordKey> nodeKeys;   //local node id -> coordinate
+        vector<string> names;        //local name id -> street name
+        vector<RawEdge> edges;       //in local ids, in file order
+    };
 
-    ExpandableHashMap<GeoCoord, vector<StreetSegment>>* m_hashMap;
+    static const size_t MIN_CHUNK_BYTES = 1 << 20;   //smaller pieces of a file aren't worth a thread
+
+    bool isStreetName(const char* line, const char* lineEnd) const;
+    void readStreetName(const char* line, const char* lineEnd, string& name) const;
+    bool readSegment(const char* line, const char* lineEnd, CoordKey& start, CoordKey& end) const;
+    void parseChunk(const char* p, const char* chunkEnd, ParsedChunk& chunk) const;
+    void splitAtStreets(const char* first, const char* last, size_t numChunks, vector<const char*>& bounds) const;
+    NodeId getOrAddNode(const CoordKey& key);
+    NameId getOrAddName(const string& name);
+    void buildGraph(const vector<RawEdge>& rawEdges);
+    void buildNodeIndex();
+    void clearMap();
+    bool isConsistent(uint64_t nameCharCount) const;
+    const SegmentGrid& segmentGrid() const;
+
+    ExpandableHashMap<CoordKey, NodeId>* m_nodeIds;   //coordinate -> dense node id, only while loading text
+    ExpandableHashMap<string, NameId>* m_nameIds;     //street name -> interned name id
+
+    //compressed sparse row graph, see StreetGraph in provided.h.  After a text load the arrays live in
+    //these vectors; after a binary load they are left empty and the views point into m_binaryFile instead
+    vector<CoordKey> m_nodeKeys;
+    vector<double> m_latitudes;
+    vector<double> m_longitudes;
+    vector<EdgeId> m_firstEdge;
+    vector<NodeId> m_edgeTargets;
+    vector<double> m_edgeLengths;
+    vector<NameId> m_edgeNames;
+    vector<uint32_t> m_nameOffsets;
+    string m_nameChars;
+    vector<NodeId> m_nodeIndex;
+    MappedFile m_binaryFile;
+    //built by the first snap after a load rather than by the load, so a binary load stays a matter of mapping the file
+    mutable SegmentGrid m_segmentGrid;
+    mutable atomic<bool> m_segmentGridBuilt;
+    mutable mutex m_segmentGridMutex;
+
+    StreetGraph m_graph;
+    const CoordKey* m_keys;         //per node
+    const NodeId* m_indexSlots;     //open addressing table of node ids by hasher(CoordKey), NO_NODE where empty
+    uint32_t m_indexMask;           //table size - 1
+    MapLoadStats m_loadStats;
+    uint64_t m_generation;   //changes whenever the map is cleared or loaded
 };
 
 StreetMapImpl::StreetMapImpl()
 {
-    m_hashMap = new ExpandableHashMap<GeoCoord, vector<StreetSegment>>;
+    m_nodeIds = new ExpandableHashMap<CoordKey, NodeId>;
+    m_nameIds = new ExpandableHashMap<string, NameId>;
+    clearMap();
 }
 
 StreetMapImpl::~StreetMapImpl()
 {
-    delete m_hashMap;
+    delete m_nodeIds;
+    delete m_nameIds;
+}
+
+namespace
+{
+    bool isBlank(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    //finds the next whitespace separated token in [p, lineEnd), leaving p just past it
+    bool nextToken(const char*& p, const char* lineEnd, const char*& tokenStart, const char*& tokenEnd)
+    {
+        while (p != lineEnd && isBlank(*p))
+            p++;
+        if (p == lineEnd)
+            return false;
+        tokenStart = p;
+        while (p != lineEnd && !isBlank(*p))
+            p++;
+        tokenEnd = p;
+        return true;
+    }
 }
 
-bool StreetMapImpl::isStreetName(string line)
+bool StreetMapImpl::isStreetName(const char* line, const char* lineEnd) const
 {
-    for (int i = 0; i != line.size(); i++)
+    for (; line != lineEnd; line++)
     {
-        if (isalpha(line[i]))
+        if (isalpha((unsigned char)*line))
             return true;
     }
     return false;
 }
 
+void StreetMapImpl::readStreetName(const char* line, const char* lineEnd, string& name) const
+{
+    //words of the name separated by single spaces, whatever spacing the file used
+    name.clear();
+    const char* wordStart;
+    const char* wordEnd;
+    while (nextToken(line, lineEnd, wordStart, wordEnd))
+    {
+        if (!name.empty())
+            name += ' ';
+        name.append(wordStart, wordEnd);
+    }
+}
 
-bool StreetMapImpl::load(string mapFile)
+bool StreetMapImpl::readSegment(const char* line, const char* lineEnd, CoordKey& start, CoordKey& end) const
 {
-    m_hashMap->reset();
+    int32_t e7[4];
+    for (int i = 0; i != 4; i++)
+    {
+        const char* tokenStart;
+        const char* tokenEnd;
+        if (!nextToken(line, lineEnd, tokenStart, tokenEnd) || !CoordKey::parseE7(tokenStart, tokenEnd, e7[i]))
+            return false;
+    }
+    start = CoordKey(e7[0], e7[1]);
+    end = CoordKey(e7[2], e7[3]);
+    return true;
+}
 
-    ifstream inf(mapFile);  //open file
+void StreetMapImpl::parseChunk(const char* p, const char* chunkEnd, ParsedChunk& chunk) const
+{
+    ExpandableHashMap<CoordKey, NodeId> localNodeIds;
+    ExpandableHashMap<string, NameId> localNameIds;
+    //segment lines are about 46 bytes, so this avoids regrowing the tables while reading
+    chunk.edges.reserve((chunkEnd - p) / 23);
+    chunk.nodeKeys.reserve((chunkEnd - p) / 46);
+    localNodeIds.reserve((chunkEnd - p) / 46);
 
-    if (!inf)  //test failure
+    NameId nameId = NO_NAME;
+    string nameOfStreet;
+    while (p != chunkEnd)  //read each line
     {
-        cerr << "Cannot open expenses file!" << endl;
-        return false;
+        const char* lineEnd = static_cast<const char*>(memchr(p, '\n', chunkEnd - p));
+        if (lineEnd == nullptr)
+            lineEnd = chunkEnd;
+
+        CoordKey start, end;
+        if (isStreetName(p, lineEnd))   //if its a street name read in the name
+        {
+            readStreetName(p, lineEnd, nameOfStreet);
+            nameId = NO_NAME;
+        }
+        else if (readSegment(p, lineEnd, start, end))   //anything else that isn't a segment (e.g. segment counts) is skipped
+        {
+            if (nameId == NO_NAME)   //first segment of this street in this chunk
+            {
+                const NameId* known = localNameIds.find(nameOfStreet);
+                nameId = (known != nullptr ? *known : (NameId)chunk.names.size());
+                if (known == nullptr)
+                {
+                    localNameIds.associate(nameOfStreet, nameId);
+                    chunk.names.push_back(nameOfStreet);
+                }
+            }
+
+            NodeId ends[2];
+            CoordKey keys[2] = { start, end };
+            for (int i = 0; i != 2; i++)   //local ids are handed out in order of first appearance in the chunk
+            {
+                const NodeId* known = localNodeIds.find(keys[i]);
+                ends[i] = (known != nullptr ? *known : (NodeId)chunk.nodeKeys.size());
+                if (known == nullptr)
+                {
+                    localNodeIds.associate(keys[i], ends[i]);
+                    chunk.nodeKeys.push_back(keys[i]);
+                }
+            }
+
+            //each segment is stored once in each direction so it can be found from either endpoint
+            RawEdge forward = { ends[0], ends[1], nameId,
+                                distanceEarthMiles(start.latitude(), start.longitude(), end.latitude(), end.longitude()) };
+            RawEdge backward = { forward.to, forward.from, nameId, forward.length };
+            chunk.edges.push_back(forward);
+            chunk.edges.push_back(backward);
+        }
+        p = (lineEnd == chunkEnd ? chunkEnd : lineEnd + 1);
     }
+}
 
-    string line, nameOfStreet;
-    while (getline(inf, line))  //read each line
+void StreetMapImpl::splitAtStreets(const char* first, const char* last, size_t numChunks, vector<const char*>& bounds) const
+{
+    //a chunk may only start on a street name line, so every segment stays with the street it belongs to
+    bounds.assign(1, first);
+    for (size_t i = 1; i < numChunks; i++)
     {
-        istringstream iss(line);  //creates input stringstream from line
-        string startLat, startLong, endLat, endLong;
-
-        if (isStreetName(line))   //if its a street name read in the name then continue
+        const char* p = max(bounds.back(), first + (last - first) / numChunks * i);
+        while (p != last)
         {
-            string temp;
-            nameOfStreet = "";
-            while (iss >> temp)
+            const char* lineStart = p;   //p is at the start of a line unless it is the rough split point
+            if (lineStart != first && lineStart[-1] != '\n')
             {
-                if (nameOfStreet != "")
-                    nameOfStreet += " ";
-                nameOfStreet += temp;
+                const char* nl = static_cast<const char*>(memchr(p, '\n', last - p));
+                if (nl == nullptr)
+                {
+                    p = last;
+                    break;
+                }
+                p = lineStart = nl + 1;
             }
-            continue;
+            const char* lineEnd = static_cast<const char*>(memchr(lineStart, '\n', last - lineStart));
+            if (lineEnd == nullptr)
+                lineEnd = last;
+            if (isStreetName(lineStart, lineEnd))
+                break;
+            p = (lineEnd == last ? last : lineEnd + 1);
         }
+        if (p != bounds.back())
+            bounds.push_back(p);
+    }
+    bounds.push_back(last);
+}
 
-        if (!(iss >> startLat >> startLong >> endLat >> endLong))  //if its not a segment then continue
-            continue;
+bool StreetMapImpl::load(string mapFile)
+{
+    chrono::steady_clock::time_point loadStart = chrono::steady_clock::now();
+    clearMap();
 
-        GeoCoord start(startLat, startLong);   //starting coord
-        GeoCoord end(endLat, endLong);         //ending coord
-        StreetSegment s(start, end, nameOfStreet);   //dynamically allocate new segment: startcoord, endcoord, streetname
-        insertInHashMap(start, s);   //map starting coord to segment
-        StreetSegment sReversed(end, start, nameOfStreet);   //dynamically allocate new segment: startcoord, endcoord, streetname
-        insertInHashMap(end, sReversed);   //map ending coord to segment 
+    MappedFile file;
+    if (!file.open(mapFile))  //test failure
+    {
+        cerr << "Cannot open map data file!" << endl;
+        return false;
     }
+
+    //streets are independent blocks, so chunks of whole streets are parsed in parallel, each numbering
+    //its own nodes and names; a small file is one chunk, since threads wouldn't pay for themselves
+    ThreadPool& pool = ThreadPool::shared();
+    size_t numChunks = min<size_t>(pool.size() * 4, file.size() / MIN_CHUNK_BYTES + 1);
+    vector<const char*> bounds;
+    splitAtStreets(file.data(), file.data() + file.size(), numChunks, bounds);
+    vector<ParsedChunk> chunks(bounds.size() - 1);
+    pool.parallelFor(chunks.size(), [&](size_t i) {
+        parseChunk(bounds[i], bounds[i + 1], chunks[i]);
+    });
+
+    //merging chunk by chunk in file order gives every node and name the id a single pass would have
+    vector<vector<NodeId>> globalNodeIds(chunks.size());
+    vector<vector<NameId>> globalNameIds(chunks.size());
+    vector<size_t> firstRawEdge(chunks.size() + 1, 0);
+    m_nodeIds->reserve(file.size() / 46);
+    for (size_t c = 0; c != chunks.size(); c++)
+    {
+        for (size_t i = 0; i != chunks[c].nodeKeys.size(); i++)
+            globalNodeIds[c].push_back(getOrAddNode(chunks[c].nodeKeys[i]));
+        for (size_t i = 0; i != chunks[c].names.size(); i++)
+            globalNameIds[c].push_back(getOrAddName(chunks[c].names[i]));
+        firstRawEdge[c + 1] = firstRawEdge[c] + chunks[c].edges.size();
+    }
+
+    vector<RawEdge> rawEdges(firstRawEdge.back());
+    pool.parallelFor(chunks.size(), [&](size_t c) {
+        for (size_t i = 0; i != chunks[c].edges.size(); i++)
+        {
+            const RawEdge& local = chunks[c].edges[i];
+            RawEdge global = { globalNodeIds[c][local.from], globalNodeIds[c][local.to], globalNameIds[c][local.name], local.length };
+            rawEdges[firstRawEdge[c] + i] = global;
+        }
+        chunks[c] = ParsedChunk();   //free it while the other chunks are still being translated
+    });
+
+    buildGraph(rawEdges);
+    m_nodeIds->reset();   //lookups go through the node index from here on
+    m_nameIds->reset();
+
+    m_loadStats.bytes = file.size();
+    m_loadStats.segments = rawEdges.size() / 2;
+    m_loadStats.seconds = chrono::duration<double>(chrono::steady_clock::now() - loadStart).count();
     return true;
 }
 
-void StreetMapImpl::insertInHashMap(const GeoCoord& coord, StreetSegment seg)
+NodeId StreetMapImpl::getOrAddNode(const CoordKey& key)
+{
+    const NodeId* id = m_nodeIds->find(key);
+    if (id != nullptr)
+        return *id;
+    NodeId newId = (NodeId)m_nodeKeys.size();   //ids are handed out in order of first appearance in the file
+    m_nodeIds->associate(key, newId);
+    m_nodeKeys.push_back(key);
+    return newId;
+}
+
+NameId StreetMapImpl::getOrAddName(const string& name)
 {
-    if (m_hashMap->find(coord) != nullptr)  //association exists   //mapping geoCoords to a vector of street pointers
+    const NameId* id = m_nameIds->find(name);
+    if (id != nullptr)
+        return *id;
+    NameId newId = (NameId)(m_nameOffsets.size() - 1);
+    m_nameIds->associate(name, newId);
+    m_nameChars += name;
+    m_nameOffsets.push_back((uint32_t)m_nameChars.size());
+    return newId;
+}
+
+void StreetMapImpl::buildGraph(const vector<RawEdge>& rawEdges)
+{
+    size_t numNodes = m_nodeKeys.size();
+    m_latitudes.resize(numNodes);
+    m_longitudes.resize(numNodes);
+    for (size_t i = 0; i != numNodes; i++)
     {
-        vector<StreetSegment>* segs = m_hashMap->find(coord);   //get vector of segments for this specific coord   
-        segs->push_back(seg);   //add new streetsegment pointer to street segment to vector
+        m_latitudes[i] = m_nodeKeys[i].latitude();
+        m_longitudes[i] = m_nodeKeys[i].longitude();
     }
-    else  //association doesn't exist
+
+    //counting sort of the edges by starting node, keeping file order within each node
+    m_firstEdge.assign(numNodes + 1, 0);
+    for (vector<RawEdge>::const_iterator it = rawEdges.begin(); it != rawEdges.end(); it++)
+        m_firstEdge[it->from + 1]++;
+    for (size_t i = 0; i != numNodes; i++)
+        m_firstEdge[i + 1] += m_firstEdge[i];
+
+    vector<EdgeId> nextSlot(m_firstEdge.begin(), m_firstEdge.end() - 1);
+    m_edgeTargets.resize(rawEdges.size());
+    m_edgeLengths.resize(rawEdges.size());
+    m_edgeNames.resize(rawEdges.size());
+    for (vector<RawEdge>::const_iterator it = rawEdges.begin(); it != rawEdges.end(); it++)
+    {
+        EdgeId e = nextSlot[it->from]++;
+        m_edgeTargets[e] = it->to;
+        m_edgeLengths[e] = it->length;
+        m_edgeNames[e] = it->name;
+    }
+
+    m_graph.nodeCount = (uint32_t)numNodes;
+    m_graph.edgeCount = (uint32_t)rawEdges.size();
+    m_graph.nameCount = (uint32_t)(m_nameOffsets.size() - 1);
+    m_graph.latitudes = m_latitudes.data();
+    m_graph.longitudes = m_longitudes.data();
+    m_graph.firstEdge = m_firstEdge.data();
+    m_graph.edgeTargets = m_edgeTargets.data();
+    m_graph.edgeLengths = m_edgeLengths.data();
+    m_graph.edgeNames = m_edgeNames.data();
+    m_graph.nameOffsets = m_nameOffsets.data();
+    m_graph.nameChars = m_nameChars.data();
+    m_keys = m_nodeKeys.data();
+    buildNodeIndex();
+}
+
+void StreetMapImpl::buildNodeIndex()
+{
+    //linear probing table at most half full; it is a flat array so it can be saved and mapped with the graph
+    uint32_t tableSize = 8;
+    while (tableSize < 2 * (size_t)m_graph.nodeCount)
+        tableSize *= 2;
+    m_nodeIndex.assign(tableSize, NO_NODE);
+    m_indexMask = tableSize - 1;
+    for (NodeId id = 0; id != m_graph.nodeCount; id++)
     {
-        vector<StreetSegment> newSeg;
-        newSeg.push_back(seg);          //add segment to vector 
-        m_hashMap->associate(coord, newSeg);   //add new association 
+        uint32_t slot = hasher(m_keys[id]) & m_indexMask;
+        while (m_nodeIndex[slot] != NO_NODE)
+            slot = (slot + 1) & m_indexMask;
+        m_nodeIndex[slot] = id;
     }
+    m_indexSlots = m_nodeIndex.data();
+}
+
+void StreetMapImpl::clearMap()
+{
+    m_nodeIds->reset();
+    m_nameIds->reset();
+    m_nodeKeys.clear();
+    m_latitudes.clear();
+    m_longitudes.clear();
+    m_firstEdge.assign(1, 0);
+    m_edgeTargets.clear();
+    m_edgeLengths.clear();
+    m_edgeNames.clear();
+    m_nameOffsets.assign(1, 0);
+    m_nameChars.clear();
+    m_nodeIndex.assign(1, NO_NODE);
+    m_binaryFile.close();
+    m_segmentGrid.clear();
+    m_segmentGridBuilt = false;
+
+    //an empty map still has valid (empty) arrays, so lookups and edge walks need no special case
+    m_graph = StreetGraph();
+    m_graph.firstEdge = m_firstEdge.data();
+    m_graph.nameOffsets = m_nameOffsets.data();
+    m_graph.nameChars = m_nameChars.data();
+    m_keys = m_nodeKeys.data();
+    m_indexSlots = m_nodeIndex.data();
+    m_indexMask = 0;
+    m_loadStats = MapLoadStats();
+    m_generation = nextGeneration++;
 }
 
 bool StreetMapImpl::getSegmentsThatStartWith(const GeoCoord& gc, vector<StreetSegment>& segs) const
 {
-    if (m_hashMap->find(gc) != nullptr)  //if geocoordinate exists in hashmap
+    NodeId from;
+    EdgeRange edges;
+    if (!getEdgesThatStartWith(gc, from, edges))  //if geocoordinate isn't the end of any segment
+        return false;
+
+    segs.clear();
+    for (EdgeId e : edges)   //copy segments into segs
+        segs.push_back(getSegment(from, e));
+    return true;
+}
+
+const StreetGraph& StreetMapImpl::graph() const
+{
+    return m_graph;
+}
+
+bool StreetMapImpl::getNodeId(const GeoCoord& gc, NodeId& id) const
+{
+    return getNodeId(CoordKey(gc), id);
+}
+
+bool StreetMapImpl::getNodeId(const CoordKey& key, NodeId& id) const
+{
+    for (uint32_t slot = hasher(key) & m_indexMask; m_indexSlots[slot] != NO_NODE; slot = (slot + 1) & m_indexMask)
     {
-        while (!segs.empty())
+        if (m_keys[m_indexSlots[slot]] == key)
         {
-            vector<StreetSegment>::iterator it = segs.begin();
-            it = segs.erase(it);
+            id = m_indexSlots[slot];
+            return true;
         }
-
-        vector<StreetSegment>* neededSegs = m_hashMap->find(gc);   //get vector of segments mapped to specific geocoordinate
-        for (vector<StreetSegment>::iterator it = (*neededSegs).begin(); it != (*neededSegs).end(); it++)  //copy segments into segs
-            segs.push_back(*it);
-        return true;
     }
     return false;
 }
 
+CoordKey StreetMapImpl::getNodeKey(NodeId id) const
+{
+    return m_keys[id];
+}
+
+GeoCoord StreetMapImpl::getNodeCoord(NodeId id) const
+{
+    return m_keys[id].toGeoCoord();
+}
+
+bool StreetMapImpl::getEdgesThatStartWith(const GeoCoord& gc, NodeId& from, EdgeRange& edges) const
+{
+    if (!getNodeId(gc, from))
+        return false;
+    edges = m_graph.edgesFrom(from);
+    return true;
+}
+
+StreetSegment StreetMapImpl::getSegment(NodeId from, EdgeId e) const
+{
+    NameId name = m_graph.edgeNames[e];
+    return StreetSegment(getNodeCoord(from), getNodeCoord(m_graph.edgeTargets[e]), m_graph.streetName(name), name);
+}
+
+const SegmentGrid& StreetMapImpl::segmentGrid() const
+{
+    //snaps can come from several threads at once; the first to get here builds the grid and the rest wait for it
+    if (!m_segmentGridBuilt.load(memory_order_acquire))
+    {
+        lock_guard<mutex> lock(m_segmentGridMutex);
+        if (!m_segmentGridBuilt.load(memory_order_relaxed))
+        {
+            m_segmentGrid.build(m_graph);
+            m_segmentGridBuilt.store(true, memory_order_release);
+        }
+    }
+    return m_segmentGrid;
+}
+
+bool StreetMapImpl::snapToSegment(const GeoCoord& gc, SnappedPoint& snapped) const
+{
+    NodeId from;
+    EdgeId edge;
+    double fraction;
+    if (!segmentGrid().nearest(m_graph, gc.latitude, gc.longitude, from, edge, fraction))
+        return false;
+
+    //interpolate in whole 1e-7 degrees, so the point has the same fixed-point form as the map's own coordinates
+    NodeId to = m_graph.edgeTargets[edge];
+    CoordKey a = m_keys[from], b = m_keys[to];
+    CoordKey point((int32_t)(a.latitudeE7() + llround(fraction * ((double)b.latitudeE7() - a.latitudeE7()))),
+                   (int32_t)(a.longitudeE7() + llround(fraction * ((double)b.longitudeE7() - a.longitudeE7()))));
+    if (point == a)   //rounded onto an end: say so exactly, so callers can treat it as that node
+        fraction = 0;
+    else if (point == b)
+        fraction = 1;
+
+    snapped.from = from;
+    snapped.to = to;
+    snapped.edge = edge;
+    snapped.fraction = fraction;
+    snapped.point = point.toGeoCoord();
+    snapped.offMapMiles = distanceEarthMiles(gc, snapped.point);
+    return true;
+}
+
+MapLoadStats StreetMapImpl::getLoadStats() const
+{
+    return m_loadStats;
+}
+
+uint64_t StreetMapImpl::generation() const
+{
+    return m_generation;
+}
+
+//******************** Binary map files ****************************************
+
+namespace
+{
+    //A binary map file is a MapFileHeader followed by the sections in MapSection order, each starting
+    //on an 8 byte boundary and zero padded to a multiple of 8 bytes.  Every array is stored exactly as
+    //StreetMapImpl uses it in memory, so a mapped file is used in place with no parsing or rebuilding.
+    //Bump MAP_FILE_VERSION whenever the layout, the node numbering, or hasher(CoordKey) changes.
+    const char MAP_FILE_MAGIC[8] = { 'D', 'N', 'S', 'T', 'M', 'A', 'P', '\0' };
+    const uint32_t MAP_FILE_VERSION = 1;
+    const uint32_t MAP_FILE_BYTE_ORDER = 0x01020304;   //reads back differently on a machine of the other endianness
+
+    enum MapSection
+    {
+        NODE_KEYS, LATITUDES, LONGITUDES, FIRST_EDGE, EDGE_TARGETS, EDGE_LENGTHS, EDGE_NAMES,
+        NAME_OFFSETS, NAME_CHARS, NODE_INDEX, NUM_SECTIONS
+    };
+
+    struct MapFileHeader
+    {
+        char     magic[8];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint32_t nodeCount;
+        uint32_t edgeCount;
+        uint32_t nameCount;
+        uint32_t indexSize;
+        uint64_t checksum;                     //of every byte after the header
+        uint64_t sectionOffset[NUM_SECTIONS];  //from the start of the file
+        uint64_t sectionBytes[NUM_SECTIONS];   //unpadded
+    };
+
+    static_assert(sizeof(MapFileHeader) % 8 == 0, "sections must start 8 byte aligned");
+    static_assert(sizeof(CoordKey) == sizeof(uint64_t), "CoordKeys are stored as raw 64-bit values");
+
+    uint64_t padTo8(uint64_t n)
+    {
+        return (n + 7) & ~(uint64_t)7;
+    }
+}
+
+bool StreetMapImpl::saveBinary(string binaryFile) const
+{
+    const char* data[NUM_SECTIONS] = {
+        reinterpret_cast<const char*>(m_keys), reinterpret_cast<const char*>(m_graph.latitudes),
+        reinterpret_cast<const char*>(m_graph.longitudes), reinterpret_cast<const char*>(m_graph.firstEdge),
+        reinterpret_cast<const char*>(m_graph.edgeTargets), reinterpret_cast<const char*>(m_graph.edgeLengths),
+        reinterpret_cast<const char*>(m_graph.edgeNames), reinterpret_cast<const char*>(m_graph.nameOffsets),
+        m_graph.nameChars, reinterpret_cast<const char*>(m_indexSlots)
+    };
+
+    MapFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MAP_FILE_MAGIC, sizeof(header.magic));
+    header.version = MAP_FILE_VERSION;
+    header.byteOrder = MAP_FILE_BYTE_ORDER;
+    header.nodeCount = m_graph.nodeCount;
+    header.edgeCount = m_graph.edgeCount;
+    header.nameCount = m_graph.nameCount;
+    header.indexSize = m_indexMask + 1;
+    header.sectionBytes[NODE_KEYS] = sizeof(CoordKey) * (uint64_t)header.nodeCount;
+    header.sectionBytes[LATITUDES] = sizeof(double) * (uint64_t)header.nodeCount;
+    header.sectionBytes[LONGITUDES] = sizeof(double) * (uint64_t)header.nodeCount;
+    header.sectionBytes[FIRST_EDGE] = sizeof(EdgeId) * ((uint64_t)header.nodeCount + 1);
+    header.sectionBytes[EDGE_TARGETS] = sizeof(NodeId) * (uint64_t)header.edgeCount;
+    header.sectionBytes[EDGE_LENGTHS] = sizeof(double) * (uint64_t)header.edgeCount;
+    header.sectionBytes[EDGE_NAMES] = sizeof(NameId) * (uint64_t)header.edgeCount;
+    header.sectionBytes[NAME_OFFSETS] = sizeof(uint32_t) * ((uint64_t)header.nameCount + 1);
+    header.sectionBytes[NAME_CHARS] = m_graph.nameOffsets[header.nameCount];
+    header.sectionBytes[NODE_INDEX] = sizeof(NodeId) * (uint64_t)header.indexSize;
+
+    uint64_t offset = sizeof(MapFileHeader);
+    header.checksum = CHECKSUM_SEED;
+    for (int i = 0; i != NUM_SECTIONS; i++)
+    {
+        header.sectionOffset[i] = offset;
+        offset += padTo8(header.sectionBytes[i]);
+        header.checksum = addToChecksum(header.checksum, data[i], header.sectionBytes[i]);
+    }
+
+    ofstream outf(binaryFile, ios::binary | ios::trunc);
+    if (!outf)
+    {
+        cerr << "Cannot create binary map file!" << endl;
+        return false;
+    }
+    const char padding[8] = { 0 };
+    outf.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (int i = 0; i != NUM_SECTIONS; i++)
+    {
+        outf.write(data[i], header.sectionBytes[i]);
+        outf.write(padding, padTo8(header.sectionBytes[i]) - header.sectionBytes[i]);
+    }
+    return (bool)outf.flush();
+}
+
+bool StreetMapImpl::loadBinary(string binaryFile)
+{
+    chrono::steady_clock::time_point loadStart = chrono::steady_clock::now();
+    clearMap();
+
+    if (!m_binaryFile.open(binaryFile))
+    {
+        cerr << "Cannot open binary map file!" << endl;
+        return false;
+    }
+
+    const char* base = m_binaryFile.data();
+    MapFileHeader header;
+    if (m_binaryFile.size() < sizeof(header))
+    {
+        cerr << "Not a binary map file!" << endl;
+        clearMap();
+        return false;
+    }
+    memcpy(&header, base, sizeof(header));
+    if (memcmp(header.magic, MAP_FILE_MAGIC, sizeof(header.magic)) != 0)
+    {
+        cerr << "Not a binary map file!" << endl;
+        clearMap();
+        return false;
+    }
+    if (header.version != MAP_FILE_VERSION || header.byteOrder != MAP_FILE_BYTE_ORDER)
+    {
+        cerr << "Binary map file was written by an incompatible version, rebuild it from the text map!" << endl;
+        clearMap();
+        return false;
+    }
+
+    //every section must be where the writer would have put it, with the size its counts imply
+    const uint64_t expectedBytes[NUM_SECTIONS] = {
+        sizeof(CoordKey) * (uint64_t)header.nodeCount, sizeof(double) * (uint64_t)header.nodeCount,
+        sizeof(double) * (uint64_t)header.nodeCount, sizeof(EdgeId) * ((uint64_t)header.nodeCount + 1),
+        sizeof(NodeId) * (uint64_t)header.edgeCount, sizeof(double) * (uint64_t)header.edgeCount,
+        sizeof(NameId) * (uint64_t)header.edgeCount, sizeof(uint32_t) * ((uint64_t)header.nameCount + 1),
+        header.sectionBytes[NAME_CHARS], sizeof(NodeId) * (uint64_t)header.indexSize
+    };
+    uint64_t offset = sizeof(MapFileHeader);
+    bool valid = header.indexSize != 0 && (header.indexSize & (header.indexSize - 1)) == 0 && header.indexSize > header.nodeCount;
+    for (int i = 0; i != NUM_SECTIONS && valid; i++)
+    {
+        valid = header.sectionOffset[i] == offset && header.sectionBytes[i] == expectedBytes[i];
+        offset += padTo8(header.sectionBytes[i]);
+    }
+    valid = valid && offset == m_binaryFile.size() &&
+            addToChecksum(CHECKSUM_SEED, base + sizeof(header), m_binaryFile.size() - sizeof(header)) == header.checksum;
+    if (!valid)
+    {
+        cerr << "Binary map file is truncated or corrupt!" << endl;
+        clearMap();
+        return false;
+    }
+
+    m_keys = reinterpret_cast<const CoordKey*>(base + header.sectionOffset[NODE_KEYS]);
+    m_graph.nodeCount = header.nodeCount;
+    m_graph.edgeCount = header.edgeCount;
+    m_graph.nameCount = header.nameCount;
+    m_graph.latitudes = reinterpret_cast<const double*>(base + header.sectionOffset[LATITUDES]);
+    m_graph.longitudes = reinterpret_cast<const double*>(base + header.sectionOffset[LONGITUDES]);
+    m_graph.firstEdge = reinterpret_cast<const EdgeId*>(base + header.sectionOffset[FIRST_EDGE]);
+    m_graph.edgeTargets = reinterpret_cast<const NodeId*>(base + header.sectionOffset[EDGE_TARGETS]);
+    m_graph.edgeLengths = reinterpret_cast<const double*>(base + header.sectionOffset[EDGE_LENGTHS]);
+    m_graph.edgeNames = reinterpret_cast<const NameId*>(base + header.sectionOffset[EDGE_NAMES]);
+    m_graph.nameOffsets = reinterpret_cast<const uint32_t*>(base + header.sectionOffset[NAME_OFFSETS]);
+    m_graph.nameChars = base + header.sectionOffset[NAME_CHARS];
+    m_indexSlots = reinterpret_cast<const NodeId*>(base + header.sectionOffset[NODE_INDEX]);
+    m_indexMask = header.indexSize - 1;
+    if (!isConsistent(header.sectionBytes[NAME_CHARS]))
+    {
+        cerr << "Binary map file is truncated or corrupt!" << endl;
+        clearMap();
+        return false;
+    }
+
+    m_loadStats.bytes = m_binaryFile.size();
+    m_loadStats.segments = header.edgeCount / 2;
+    m_loadStats.seconds = chrono::duration<double>(chrono::steady_clock::now() - loadStart).count();
+    return true;
+}
+
+bool StreetMapImpl::isConsistent(uint64_t nameCharCount) const
+{
+    //the checksum only shows the file is as written; this shows what was written is a graph every lookup and edge walk
+    //can trust, in one pass over the arrays
+    const StreetGraph& g = m_graph;
+    if (g.firstEdge[0] != 0 || g.firstEdge[g.nodeCount] != g.edgeCount)
+        return false;
+    for (NodeId n = 0; n != g.nodeCount; n++)
+    {
+        if (g.firstEdge[n + 1] < g.firstEdge[n])
+            return false;
+    }
+    for (EdgeId e = 0; e != g.edgeCount; e++)
+    {
+        if (g.edgeTargets[e] >= g.nodeCount || g.edgeNames[e] >= g.nameCount)
+            return false;
+    }
+    if (g.nameOffsets[0] != 0 || g.nameOffsets[g.nameCount] != nameCharCount)
+        return false;
+    for (NameId i = 0; i != g.nameCount; i++)
+    {
+        if (g.nameOffsets[i + 1] < g.nameOffsets[i])
+            return false;
+    }
+    //every node in exactly one slot of the node index, so with more slots than nodes some slot is empty and a lookup
+    //of a missing key ends there instead of probing forever
+    vector<bool> indexed(g.nodeCount, false);
+    for (uint64_t slot = 0; slot <= m_indexMask; slot++)
+    {
+        NodeId id = m_indexSlots[slot];
+        if (id == NO_NODE)
+            continue;
+        if (id >= g.nodeCount || indexed[id])
+            return false;
+        indexed[id] = true;
+    }
+    for (NodeId n = 0; n != g.nodeCount; n++)
+    {
+        if (!indexed[n])
+            return false;
+    }
+    return true;
+}
+
 //******************** StreetMap functions ************************************
 
 // These functions simply delegate to StreetMapImpl's functions.
@@ -154,3 +820,63 @@ bool StreetMap::getSegmentsThatStartWith(const GeoCoord& gc, vector<StreetSegmen
 {
     return m_impl->getSegmentsThatStartWith(gc, segs);
 }
+
+const StreetGraph& StreetMap::graph() const
+{
+    return m_impl->graph();
+}
+
+bool StreetMap::getNodeId(const GeoCoord& gc, NodeId& id) const
+{
+    return m_impl->getNodeId(gc, id);
+}
+
+bool StreetMap::getNodeId(const CoordKey& key, NodeId& id) const
+{
+    return m_impl->getNodeId(key, id);
+}
+
+CoordKey StreetMap::getNodeKey(NodeId id) const
+{
+    return m_impl->getNodeKey(id);
+}
+
+GeoCoord StreetMap::getNodeCoord(NodeId id) const
+{
+    return m_impl->getNodeCoord(id);
+}
+
+bool StreetMap::getEdgesThatStartWith(const GeoCoord& gc, NodeId& from, EdgeRange& edges) const
+{
+    return m_impl->getEdgesThatStartWith(gc, from, edges);
+}
+
+StreetSegment StreetMap::getSegment(NodeId from, EdgeId e) const
+{
+    return m_impl->getSegment(from, e);
+}
+
+bool StreetMap::snapToSegment(const GeoCoord& gc, SnappedPoint& snapped) const
+{
+    return m_impl->snapToSegment(gc, snapped);
+}
+
+MapLoadStats StreetMap::getLoadStats() const
+{
+    return m_impl->getLoadStats();
+}
+
+uint64_t StreetMap::generation() const
+{
+    return m_impl->generation();
+}
+
+bool StreetMap::saveBinary(string binaryFile) const
+{
+    return m_impl->saveBinary(binaryFile);
+}
+
+bool StreetMap::loadBinary(string binaryFile)
+{
+    return m_impl->loadBinary(binaryFile);
+}
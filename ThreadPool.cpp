@@ -0,0 +1,131 @@
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+using namespace std;
+
+//Runs independent pieces of work on a fixed set of threads
+
+namespace
+{
+    //state of one parallelFor call; held by shared_ptr because a helper may only get to run after the call has returned
+    struct ParallelForState
+    {
+        ParallelForState(size_t n, const function<void(size_t)>& t)
+            : count(n), task(t), next(0), finished(0)
+        {}
+
+        //claims and runs indices until none are left
+        void work()
+        {
+            for (size_t i = next++; i < count; i = next++)
+            {
+                try
+                {
+                    task(i);
+                }
+                catch (...)
+                {
+                    lock_guard<mutex> lock(m);
+                    if (!error)
+                        error = current_exception();
+                }
+                if (++finished == count)
+                {
+                    lock_guard<mutex> lock(m);
+                    allDone.notify_all();
+                }
+            }
+        }
+
+        const size_t count;
+        const function<void(size_t)>& task;   //only used while indices remain, i.e. while the caller is still waiting
+        atomic<size_t> next;
+        atomic<size_t> finished;
+        mutex m;
+        condition_variable allDone;
+        exception_ptr error;
+    };
+}
+
+ThreadPool::ThreadPool(unsigned int numThreads)
+    :m_stopping(false)
+{
+    if (numThreads == 0)
+        numThreads = thread::hardware_concurrency();
+    //the thread calling parallelFor also does work, so it counts as one of the threads
+    for (unsigned int i = 1; i < numThreads; i++)
+        m_workers.push_back(thread(&ThreadPool::workerLoop, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_jobReady.notify_all();
+    for (size_t i = 0; i != m_workers.size(); i++)
+        m_workers[i].join();
+}
+
+unsigned int ThreadPool::size() const
+{
+    return (unsigned int)m_workers.size() + 1;
+}
+
+void ThreadPool::parallelFor(size_t count, const function<void(size_t)>& task)
+{
+    if (count == 0)
+        return;
+    if (count == 1 || m_workers.empty())
+    {
+        for (size_t i = 0; i != count; i++)
+            task(i);
+        return;
+    }
+
+    shared_ptr<ParallelForState> state = make_shared<ParallelForState>(count, task);
+    size_t helpers = min(count - 1, m_workers.size());
+    for (size_t i = 0; i != helpers; i++)
+        enqueue([state]() { state->work(); });
+    state->work();
+
+    unique_lock<mutex> lock(state->m);
+    state->allDone.wait(lock, [&state]() { return state->finished == state->count; });
+    if (state->error)
+        rethrow_exception(state->error);
+}
+
+ThreadPool& ThreadPool::shared()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::enqueue(function<void()> job)
+{
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_jobs.push_back(move(job));
+    }
+    m_jobReady.notify_one();
+}
+
+void ThreadPool::workerLoop()
+{
+    for (;;)
+    {
+        function<void()> job;
+        {
+            unique_lock<mutex> lock(m_mutex);
+            m_jobReady.wait(lock, [this]() { return m_stopping || !m_jobs.empty(); });
+            if (m_jobs.empty())   //only reached when stopping
+                return;
+            job = move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+        job();
+    }
+}
@@ -0,0 +1,51 @@
+// ThreadPool.h
+
+// Fixed set of worker threads shared by the parts of the program that split
+// independent work (map chunks, route legs, ...) across cores.
+
+#ifndef THREADPOOL_INCLUDED
+#define THREADPOOL_INCLUDED
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+    // numThreads == 0 means one worker per hardware thread
+    explicit ThreadPool(unsigned int numThreads = 0);
+    ~ThreadPool();
+
+    // number of threads that can run work at once, counting the caller of parallelFor
+    unsigned int size() const;
+
+    // Calls task(i) once for every i in [0, count), spread over the workers and
+    // the calling thread, and returns when all calls have finished.  The caller
+    // works through the indices too, so calling this from inside a task is safe.
+    // The first exception thrown by a task is rethrown here.
+    void parallelFor(std::size_t count, const std::function<void(std::size_t)>& task);
+
+    // pool used by StreetMap, the routers and the planners
+    static ThreadPool& shared();
+
+    //Prevent a ThreadPool object from being copied or assigned.
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+private:
+    void workerLoop();
+    void enqueue(std::function<void()> job);
+
+    std::vector<std::thread> m_workers;
+    std::deque<std::function<void()>> m_jobs;
+    std::mutex m_mutex;
+    std::condition_variable m_jobReady;
+    bool m_stopping;
+};
+
+#endif // THREADPOOL_INCLUDED
@@ -0,0 +1,327 @@
+// BenchSuite.cpp
+
+// End-to-end and micro benchmarks over a map file, written as one JSON object so
+// results can be kept and compared between commits:
+//   load       StreetMap::load wall time (median of several loads)
+//   route      generatePointToPointRoute latency percentiles for seeded random
+//              node pairs, for each search mode
+//   hashmap    ExpandableHashMap insert and find throughput with the map's
+//              CoordKeys and with integer keys
+//   optimize   optimizeDeliveryOrder (straight-line) and plan, the full
+//              generateDeliveryPlan, for each delivery file given, with the
+//              last plan's search counts and phase times from DeliveryPlanStats
+//
+// Built by CMake; "cmake --build build --target bench" runs it on mapdata.txt and
+// the delivery files in bench/data, and leaves the results in build/bench.json.
+// By hand:
+//   ./benchsuite [-o results.json] [--routes N] [--seed S] mapdata.txt [deliveries.txt ...]
+
+#include "provided.h"
+#include "ExpandableHashMap.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+unsigned int hasher(const unsigned int& n)
+{
+    return n * 2654435761u;
+}
+
+namespace
+{
+    double secondsSince(chrono::steady_clock::time_point start)
+    {
+        return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+
+    double median(vector<double> v)
+    {
+        sort(v.begin(), v.end());
+        return v.empty() ? 0 : v[v.size() / 2];
+    }
+
+    double percentile(const vector<double>& sorted, double p)   //nearest rank
+    {
+        if (sorted.empty())
+            return 0;
+        size_t rank = (size_t)(p / 100 * sorted.size() + 0.999999);
+        return sorted[min(sorted.size(), max(rank, (size_t)1)) - 1];
+    }
+
+    string quoted(const string& s)
+    {
+        string out = "\"";
+        for (char c : s)
+        {
+            if (c == '"' || c == '\\')
+                out += '\\';
+            out += c;
+        }
+        return out + "\"";
+    }
+
+    // Delivery file: the depot's "lat lon" on the first line, then "lat lon:item" per delivery
+    bool readDeliveries(const string& file, GeoCoord& depot, vector<DeliveryRequest>& deliveries)
+    {
+        ifstream inf(file);
+        string line;
+        if (!inf || !getline(inf, line))
+            return false;
+        istringstream depotLine(line);
+        string lat, lon;
+        if (!(depotLine >> lat >> lon))
+            return false;
+        depot = GeoCoord(lat, lon);
+        deliveries.clear();
+        while (getline(inf, line))
+        {
+            size_t colon = line.find(':');
+            istringstream coords(line.substr(0, colon));
+            if (colon == string::npos || !(coords >> lat >> lon))
+                continue;
+            deliveries.push_back(DeliveryRequest(line.substr(colon + 1), GeoCoord(lat, lon)));
+        }
+        return true;
+    }
+
+    void benchLoad(const string& mapFile, ostream& json)
+    {
+        const int RUNS = 5;
+        vector<double> seconds;
+        MapLoadStats stats;
+        for (int run = 0; run != RUNS; run++)
+        {
+            StreetMap sm;
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            sm.load(mapFile);
+            seconds.push_back(secondsSince(start));
+            stats = sm.getLoadStats();
+        }
+        double med = median(seconds);
+        json << "  \"load\": {\"runs\": " << RUNS << ", \"median_ms\": " << med * 1e3
+             << ", \"min_ms\": " << *min_element(seconds.begin(), seconds.end()) * 1e3
+             << ", \"segments\": " << stats.segments << ", \"megabytes_per_second\": " << (med > 0 ? stats.bytes / 1e6 / med : 0) << "},\n";
+    }
+
+    void benchRoutes(const StreetMap& sm, size_t numRoutes, unsigned int seed, ostream& json)
+    {
+        mt19937 rng(seed);
+        uniform_int_distribution<NodeId> pick(0, sm.graph().nodeCount - 1);
+        vector<pair<GeoCoord, GeoCoord>> pairs;
+        for (size_t i = 0; i != numRoutes; i++)
+            pairs.push_back(make_pair(sm.getNodeCoord(pick(rng)), sm.getNodeCoord(pick(rng))));
+
+        chrono::steady_clock::time_point buildStart = chrono::steady_clock::now();
+        ContractionHierarchy ch;
+        ch.build(&sm);
+        double buildSeconds = secondsSince(buildStart);
+
+        const RouteSearchMode modes[] = { SEARCH_UNIDIRECTIONAL, SEARCH_BIDIRECTIONAL, SEARCH_CONTRACTION_HIERARCHY };
+        const char* names[] = { "unidirectional", "bidirectional", "hierarchy" };
+        json << "  \"route\": {\"pairs\": " << numRoutes << ", \"seed\": " << seed << ", \"hierarchy_build_ms\": " << buildSeconds * 1e3 << ", \"modes\": {\n";
+        for (int m = 0; m != 3; m++)
+        {
+            PointToPointRouter router(&sm);
+            router.setSearchMode(modes[m]);
+            router.setContractionHierarchy(&ch);
+            vector<double> micros;
+            size_t found = 0;
+            Route route;
+            for (size_t i = 0; i != pairs.size(); i++)
+            {
+                double miles;
+                chrono::steady_clock::time_point start = chrono::steady_clock::now();
+                DeliveryResult result = router.generatePointToPointRoute(pairs[i].first, pairs[i].second, route, miles);
+                micros.push_back(secondsSince(start) * 1e6);
+                found += (result == DELIVERY_SUCCESS);
+            }
+            double total = 0;
+            for (double us : micros)
+                total += us;
+            sort(micros.begin(), micros.end());
+            json << "    " << quoted(names[m]) << ": {\"found\": " << found << ", \"mean_us\": " << total / max(micros.size(), (size_t)1)
+                 << ", \"p50_us\": " << percentile(micros, 50) << ", \"p90_us\": " << percentile(micros, 90)
+                 << ", \"p99_us\": " << percentile(micros, 99) << ", \"max_us\": " << (micros.empty() ? 0 : micros.back())
+                 << "}" << (m != 2 ? "," : "") << "\n";
+        }
+        json << "  }},\n";
+    }
+
+    template<typename Key>
+    void benchHashMap(const char* name, const vector<Key>& keys, const vector<Key>& missing, ostream& json, bool last)
+    {
+        const int ROUNDS = 5;
+        double insertSeconds = 0, hitSeconds = 0, missSeconds = 0;
+        size_t checksum = 0;
+        for (int round = 0; round != ROUNDS; round++)
+        {
+            ExpandableHashMap<Key, unsigned int> m;
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            for (size_t i = 0; i != keys.size(); i++)
+                m.associate(keys[i], (unsigned int)i);
+            insertSeconds += secondsSince(start);
+
+            start = chrono::steady_clock::now();
+            for (size_t i = 0; i != keys.size(); i++)
+                checksum += *m.find(keys[i]);
+            hitSeconds += secondsSince(start);
+
+            start = chrono::steady_clock::now();
+            for (size_t i = 0; i != missing.size(); i++)
+                checksum += (m.find(missing[i]) == nullptr);
+            missSeconds += secondsSince(start);
+        }
+        double ops = (double)keys.size() * ROUNDS / 1e6, missOps = (double)missing.size() * ROUNDS / 1e6;
+        json << "    " << quoted(name) << ": {\"keys\": " << keys.size()
+             << ", \"insert_mops\": " << (insertSeconds > 0 ? ops / insertSeconds : 0)
+             << ", \"find_hit_mops\": " << (hitSeconds > 0 ? ops / hitSeconds : 0)
+             << ", \"find_miss_mops\": " << (missSeconds > 0 ? missOps / missSeconds : 0)
+             << ", \"checksum\": " << checksum << "}" << (last ? "" : ",") << "\n";
+    }
+
+    void benchHashMaps(const StreetMap& sm, unsigned int seed, ostream& json)
+    {
+        //the map's own node coordinates, then coordinates just off them that aren't on the map
+        const StreetGraph& g = sm.graph();
+        vector<CoordKey> coords, missingCoords;
+        for (NodeId n = 0; n != g.nodeCount; n++)
+        {
+            CoordKey k = sm.getNodeKey(n);
+            coords.push_back(k);
+            NodeId unused;
+            CoordKey off(k.latitudeE7() + 1, k.longitudeE7());
+            if (!sm.getNodeId(off, unused))
+                missingCoords.push_back(off);
+        }
+        mt19937 rng(seed);
+        shuffle(coords.begin(), coords.end(), rng);
+
+        vector<unsigned int> ints, missingInts;
+        for (unsigned int i = 0; i != (unsigned int)coords.size(); i++)
+        {
+            ints.push_back(2 * i);
+            missingInts.push_back(2 * i + 1);
+        }
+        shuffle(ints.begin(), ints.end(), rng);
+
+        json << "  \"hashmap\": {\n";
+        benchHashMap("coord_keys", coords, missingCoords, json, false);
+        benchHashMap("int_keys", ints, missingInts, json, true);
+        json << "  },\n";
+    }
+
+    void benchPlans(const StreetMap& sm, const vector<string>& files, ostream& json)
+    {
+        const int RUNS = 5;
+        json << "  \"plans\": [";
+        for (size_t f = 0; f != files.size(); f++)
+        {
+            GeoCoord depot;
+            vector<DeliveryRequest> deliveries;
+            if (!readDeliveries(files[f], depot, deliveries))
+            {
+                cerr << "Unable to load delivery request file " << files[f] << endl;
+                continue;
+            }
+
+            vector<double> optimizeSeconds, planSeconds;
+            double miles = 0;
+            DeliveryResult result = DELIVERY_SUCCESS;
+            DeliveryPlanStats stats;
+            for (int run = 0; run != RUNS; run++)
+            {
+                DeliveryOptimizer optimizer(&sm);
+                vector<DeliveryRequest> reordered = deliveries;
+                double oldCrow, newCrow;
+                chrono::steady_clock::time_point start = chrono::steady_clock::now();
+                optimizer.optimizeDeliveryOrder(depot, reordered, oldCrow, newCrow);
+                optimizeSeconds.push_back(secondsSince(start));
+
+                DeliveryPlanner planner(&sm);
+                vector<DeliveryCommand> commands;
+                start = chrono::steady_clock::now();
+                result = planner.generateDeliveryPlan(depot, deliveries, commands, miles, &stats);
+                planSeconds.push_back(secondsSince(start));
+            }
+            json << (f == 0 ? "\n" : ",\n") << "    {\"file\": " << quoted(files[f]) << ", \"stops\": " << deliveries.size()
+                 << ", \"runs\": " << RUNS << ", \"result\": " << (int)result << ", \"miles\": " << miles
+                 << ", \"optimize_median_ms\": " << median(optimizeSeconds) * 1e3
+                 << ", \"plan_median_ms\": " << median(planSeconds) * 1e3
+                 << ", \"plan_min_ms\": " << *min_element(planSeconds.begin(), planSeconds.end()) * 1e3
+                 << ", \"matrix_ms\": " << stats.matrixSeconds * 1e3 << ", \"order_ms\": " << stats.optimizeSeconds * 1e3
+                 << ", \"directions_ms\": " << stats.directionsSeconds * 1e3
+                 << ", \"searches\": {\"nodes_settled\": " << stats.searches.nodesSettled
+                 << ", \"edges_relaxed\": " << stats.searches.edgesRelaxed << ", \"heap_pushes\": " << stats.searches.heapPushes
+                 << ", \"peak_frontier\": " << stats.searches.peakFrontier << ", \"allocations\": " << stats.searches.allocations
+                 << ", \"search_ms\": " << stats.searches.seconds * 1e3 << "}}";
+        }
+        json << "\n  ]\n";
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    string outputFile;
+    size_t numRoutes = 1000;
+    unsigned int seed = 42;
+    vector<string> files;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "-o" && i + 1 < argc)
+            outputFile = argv[++i];
+        else if (arg == "--routes" && i + 1 < argc)
+            numRoutes = strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--seed" && i + 1 < argc)
+            seed = (unsigned int)strtoul(argv[++i], nullptr, 10);
+        else
+            files.push_back(arg);
+    }
+    if (files.empty())
+    {
+        cout << "Usage: " << argv[0] << " [-o results.json] [--routes N] [--seed S] mapdata.txt [deliveries.txt ...]" << endl;
+        return 1;
+    }
+
+    StreetMap sm;
+    if (!sm.load(files[0]) || sm.graph().nodeCount == 0)
+    {
+        cout << "Unable to load map data file " << files[0] << endl;
+        return 1;
+    }
+
+    char when[32];
+    time_t now = time(nullptr);
+    strftime(when, sizeof(when), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+    ostringstream json;
+    json << "{\n  \"time\": " << quoted(when) << ", \"map\": " << quoted(files[0])
+         << ", \"threads\": " << ThreadPool::shared().size() << ",\n";
+    benchLoad(files[0], json);
+    benchRoutes(sm, numRoutes, seed, json);
+    benchHashMaps(sm, seed, json);
+    benchPlans(sm, vector<string>(files.begin() + 1, files.end()), json);
+    json << "}\n";
+
+    cout << json.str();
+    if (!outputFile.empty())
+    {
+        ofstream out(outputFile);
+        out << json.str();
+        if (!out)
+        {
+            cerr << "Unable to write " << outputFile << endl;
+            return 1;
+        }
+    }
+    return 0;
+}
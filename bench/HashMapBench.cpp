@@ -0,0 +1,148 @@
+// HashMapBench.cpp
+
+// Compares the open-addressing ExpandableHashMap against the original chained
+// version (ChainedHashMap.h) on the workloads the program has had: GeoCoord keys
+// hashed as text (the original StreetMap key), CoordKey keys (the current
+// StreetMap key) read from a map file, and integer keys as in per-node search
+// bookkeeping.
+//
+// Built by CMake as the hashbench target; from the repository root:
+//   cmake -S . -B build && cmake --build build --target hashbench
+//   ./build/hashbench mapdata.txt
+
+#include "provided.h"
+#include "ExpandableHashMap.h"
+#include "ChainedHashMap.h"
+#include <cctype>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+using namespace std;
+
+unsigned int hasher(const unsigned int& n)
+{
+    return n;
+}
+
+unsigned int hasher(const GeoCoord& g)
+{
+    return std::hash<string>()(g.latitudeText + g.longitudeText);
+}
+
+namespace
+{
+    double elapsedNs(chrono::steady_clock::time_point start)
+    {
+        return (double)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+    }
+
+    template<typename Map, typename Key>
+    void runBenchmark(const string& mapName, const string& keyName, const vector<Key>& keys, const vector<Key>& missing)
+    {
+        const int ROUNDS = 5;
+        double insertNs = 0, hitNs = 0, missNs = 0;
+        size_t checksum = 0;
+        for (int round = 0; round != ROUNDS; round++)
+        {
+            Map m;
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            for (size_t i = 0; i != keys.size(); i++)
+                m.associate(keys[i], (unsigned int)i);
+            insertNs += elapsedNs(start);
+
+            start = chrono::steady_clock::now();
+            for (size_t i = 0; i != keys.size(); i++)
+                checksum += *m.find(keys[i]);
+            hitNs += elapsedNs(start);
+
+            start = chrono::steady_clock::now();
+            for (size_t i = 0; i != missing.size(); i++)
+                checksum += (m.find(missing[i]) == nullptr);
+            missNs += elapsedNs(start);
+        }
+
+        double n = (double)keys.size() * ROUNDS;
+        double misses = (double)missing.size() * ROUNDS;
+        cout << mapName << " " << keyName << ": "
+             << "insert " << insertNs / n << " ns/op, "
+             << "find hit " << hitNs / n << " ns/op, "
+             << "find miss " << missNs / misses << " ns/op"
+             << "  (checksum " << checksum << ")" << endl;
+    }
+
+    bool readCoords(const string& mapFile, vector<GeoCoord>& coords)
+    {
+        ifstream inf(mapFile);
+        if (!inf)
+            return false;
+        string a, b, c, d;
+        string line;
+        while (getline(inf, line))
+        {
+            bool isStreetName = false;
+            for (size_t i = 0; i != line.size(); i++)
+                isStreetName = isStreetName || isalpha((unsigned char)line[i]);
+            istringstream iss(line);
+            if (isStreetName || !(iss >> a >> b >> c >> d))
+                continue;
+            coords.push_back(GeoCoord(a, b));
+            coords.push_back(GeoCoord(c, d));
+        }
+        return true;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc != 2)
+    {
+        cout << "Usage: " << argv[0] << " mapdata.txt" << endl;
+        return 1;
+    }
+
+    vector<GeoCoord> coords;
+    if (!readCoords(argv[1], coords))
+    {
+        cout << "Unable to load map data file " << argv[1] << endl;
+        return 1;
+    }
+
+    //distinct endpoints, as StreetMap::load would see them, plus coordinates that aren't on the map
+    ExpandableHashMap<GeoCoord, unsigned int> seen;
+    vector<GeoCoord> coordKeys;
+    for (size_t i = 0; i != coords.size(); i++)
+    {
+        if (seen.find(coords[i]) == nullptr)
+        {
+            seen.associate(coords[i], 0);
+            coordKeys.push_back(coords[i]);
+        }
+    }
+    vector<GeoCoord> coordMisses;
+    vector<CoordKey> fixedKeys, fixedMisses;
+    for (size_t i = 0; i != coordKeys.size(); i++)
+    {
+        coordMisses.push_back(GeoCoord(coordKeys[i].longitudeText, coordKeys[i].latitudeText));
+        fixedKeys.push_back(CoordKey(coordKeys[i]));
+        fixedMisses.push_back(CoordKey(coordMisses[i]));
+    }
+
+    mt19937 rng(42);
+    vector<unsigned int> intKeys, intMisses;
+    for (unsigned int i = 0; i != 1000000; i++)
+    {
+        intKeys.push_back(rng() | 1);   //odd keys present, even keys missing
+        intMisses.push_back(rng() & ~1u);
+    }
+
+    runBenchmark<ChainedHashMap<GeoCoord, unsigned int>>("chained      ", "GeoCoord", coordKeys, coordMisses);
+    runBenchmark<ExpandableHashMap<GeoCoord, unsigned int>>("open address ", "GeoCoord", coordKeys, coordMisses);
+    runBenchmark<ChainedHashMap<CoordKey, unsigned int>>("chained      ", "CoordKey", fixedKeys, fixedMisses);
+    runBenchmark<ExpandableHashMap<CoordKey, unsigned int>>("open address ", "CoordKey", fixedKeys, fixedMisses);
+    runBenchmark<ChainedHashMap<unsigned int, unsigned int>>("chained      ", "uint    ", intKeys, intMisses);
+    runBenchmark<ExpandableHashMap<unsigned int, unsigned int>>("open address ", "uint    ", intKeys, intMisses);
+}
@@ -0,0 +1,182 @@
+// RouterBench.cpp
+
+// Compares PointToPointRouter's search modes on random routes between map
+// nodes: average nodes settled and time per query, over all routes and over
+// the longest third (the cross-map routes), and checks that every mode finds
+// routes of the same length.  The contraction hierarchy is built in-process and
+// its build time reported.  Then compares routing a dispatch-style workload (a
+// few origins, many destinations each) one call at a time against the batch API.
+//
+// Built by CMake as the routerbench target; from the repository root:
+//   cmake -S . -B build && cmake --build build --target routerbench
+//   ./build/routerbench mapdata.txt [numRoutes] [seed]
+
+#include "provided.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+using namespace std;
+
+namespace
+{
+    struct RouteResult
+    {
+        double miles;
+        size_t settled;
+        double microseconds;
+    };
+
+    void runMode(const StreetMap& sm, const ContractionHierarchy& ch, RouteSearchMode mode, const vector<pair<GeoCoord, GeoCoord>>& pairs, vector<RouteResult>& results)
+    {
+        PointToPointRouter router(&sm);
+        router.setSearchMode(mode);
+        router.setContractionHierarchy(&ch);
+        list<StreetSegment> route;
+        for (size_t i = 0; i != pairs.size(); i++)
+        {
+            RouteResult r = { -1, 0, 0 };
+            RouteSearchStats stats;
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            if (router.generatePointToPointRoute(pairs[i].first, pairs[i].second, route, r.miles, &stats) != DELIVERY_SUCCESS)
+                r.miles = -1;
+            r.microseconds = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+            r.settled = stats.nodesSettled;
+            results.push_back(r);
+        }
+    }
+
+    void report(const string& name, const vector<RouteResult>& results, const vector<size_t>& which)
+    {
+        double settled = 0, micros = 0;
+        for (size_t i = 0; i != which.size(); i++)
+        {
+            settled += results[which[i]].settled;
+            micros += results[which[i]].microseconds;
+        }
+        cout << "  " << name << ": " << settled / which.size() << " nodes settled, "
+             << micros / which.size() << " us per route" << endl;
+    }
+
+    size_t runBatch(const StreetMap& sm, const ContractionHierarchy* ch, const vector<pair<GeoCoord, GeoCoord>>& pairs)
+    {
+        //returns the number of pairs whose batch distance differs from a single call's
+        PointToPointRouter router(&sm);
+        if (ch != nullptr)
+        {
+            router.setSearchMode(SEARCH_CONTRACTION_HIERARCHY);
+            router.setContractionHierarchy(ch);
+        }
+        vector<double> single(pairs.size());
+        list<StreetSegment> route;
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (size_t i = 0; i != pairs.size(); i++)
+        {
+            if (router.generatePointToPointRoute(pairs[i].first, pairs[i].second, route, single[i]) != DELIVERY_SUCCESS)
+                single[i] = 0;
+        }
+        double singleMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+        RouteBatch batch;
+        start = chrono::steady_clock::now();
+        router.generateRoutes(pairs, batch);
+        double batchMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        start = chrono::steady_clock::now();
+        router.generateRoutes(pairs, batch, true);
+        double distancesMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+        size_t mismatches = 0;
+        for (size_t i = 0; i != pairs.size(); i++)
+        {
+            if (fabs(single[i] - batch.distances[i]) > 1e-9)
+                mismatches++;
+        }
+        cout << "  " << (ch != nullptr ? "hierarchy" : "A*       ") << ": one call per pair " << singleMs << " ms, batch "
+             << batchMs << " ms, batch distances only " << distancesMs << " ms" << endl;
+        return mismatches;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2 || argc > 4)
+    {
+        cout << "Usage: " << argv[0] << " mapdata.txt [numRoutes] [seed]" << endl;
+        return 1;
+    }
+    size_t numRoutes = (argc > 2 ? strtoul(argv[2], nullptr, 10) : 1000);
+    unsigned int seed = (argc > 3 ? (unsigned int)strtoul(argv[3], nullptr, 10) : 42);
+
+    StreetMap sm;
+    if (!sm.load(argv[1]) || sm.graph().nodeCount == 0)
+    {
+        cout << "Unable to load map data file " << argv[1] << endl;
+        return 1;
+    }
+
+    mt19937 rng(seed);
+    uniform_int_distribution<NodeId> pick(0, sm.graph().nodeCount - 1);
+    vector<pair<GeoCoord, GeoCoord>> pairs;
+    vector<pair<double, size_t>> byLength;
+    for (size_t i = 0; i != numRoutes; i++)
+    {
+        pairs.push_back(make_pair(sm.getNodeCoord(pick(rng)), sm.getNodeCoord(pick(rng))));
+        byLength.push_back(make_pair(distanceEarthMiles(pairs[i].first, pairs[i].second), i));
+    }
+    sort(byLength.begin(), byLength.end());
+    vector<size_t> all, longest;
+    for (size_t i = 0; i != byLength.size(); i++)
+    {
+        all.push_back(byLength[i].second);
+        if (i >= byLength.size() * 2 / 3)
+            longest.push_back(byLength[i].second);
+    }
+
+    chrono::steady_clock::time_point buildStart = chrono::steady_clock::now();
+    ContractionHierarchy ch;
+    ch.build(&sm);
+    double buildSeconds = chrono::duration<double>(chrono::steady_clock::now() - buildStart).count();
+
+    vector<RouteResult> unidirectional, bidirectional, hierarchy;
+    runMode(sm, ch, SEARCH_UNIDIRECTIONAL, pairs, unidirectional);
+    runMode(sm, ch, SEARCH_BIDIRECTIONAL, pairs, bidirectional);
+    runMode(sm, ch, SEARCH_CONTRACTION_HIERARCHY, pairs, hierarchy);
+
+    size_t mismatches = 0;
+    for (size_t i = 0; i != pairs.size(); i++)
+    {
+        //the hierarchy adds lengths up in a different order, so allow for rounding
+        if (fabs(unidirectional[i].miles - bidirectional[i].miles) > 1e-9 || fabs(unidirectional[i].miles - hierarchy[i].miles) > 1e-9)
+            mismatches++;
+    }
+
+    cout << numRoutes << " random routes (seed " << seed << "), " << mismatches << " length mismatches" << endl;
+    cout << "Contraction hierarchy: " << ch.shortcutCount() << " shortcuts, built in " << buildSeconds << " s" << endl;
+    cout << "All routes" << endl;
+    report("unidirectional", unidirectional, all);
+    report("bidirectional ", bidirectional, all);
+    report("hierarchy     ", hierarchy, all);
+    cout << "Longest third (at least " << byLength[byLength.size() * 2 / 3].first << " crow miles)" << endl;
+    report("unidirectional", unidirectional, longest);
+    report("bidirectional ", bidirectional, longest);
+    report("hierarchy     ", hierarchy, longest);
+
+    //20 depots with 50 destinations each, followed by the random pairs above
+    vector<pair<GeoCoord, GeoCoord>> dispatch;
+    for (int origin = 0; origin != 20; origin++)
+    {
+        GeoCoord from = sm.getNodeCoord(pick(rng));
+        for (int i = 0; i != 50; i++)
+            dispatch.push_back(make_pair(from, sm.getNodeCoord(pick(rng))));
+    }
+    dispatch.insert(dispatch.end(), pairs.begin(), pairs.end());
+    cout << "Batch of " << dispatch.size() << " pairs (20 origins x 50, then the random routes)" << endl;
+    mismatches += runBatch(sm, nullptr, dispatch);
+    mismatches += runBatch(sm, &ch, dispatch);
+    cout << mismatches << " length mismatches in total" << endl;
+    return mismatches == 0 ? 0 : 1;
+}
@@ -1,4 +1,9 @@
 #include "provided.h"
+#include "PlanServer.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -6,59 +11,248 @@
 #include <vector>
 using namespace std;
 
-bool loadDeliveryRequests(string deliveriesFile, GeoCoord& depot, vector<DeliveryRequest>& v);
-bool parseDelivery(string line, string& lat, string& lon, string& item);
+bool loadMap(string mapFile, StreetMap& sm);
+bool loadDeliveryRequests(string deliveriesFile, GeoCoord& depot, vector<DeliveryRequest>& v, ostream& messages);
+bool parseDelivery(string line, string& lat, string& lon, string& item, ostream& messages);
+bool planDeliveries(const DeliveryPlanner& dp, string deliveriesFile, ostream& out, double& totalMiles, string& outcome);
+int serve(string mapFile, string socketPath);
+int runBatch(string mapFile, string deliveriesSource, string outputDirectory);
 
 int main(int argc, char* argv[])
 {
+    if (argc >= 3 && argc <= 4 && string(argv[1]) == "--serve")
+        return serve(argv[2], argc == 4 ? argv[3] : "");
+    if (argc == 5 && string(argv[1]) == "--batch")
+        return runBatch(argv[2], argv[3], argv[4]);
     if (argc != 3)
     {
         cout << "Usage: " << argv[0] << " mapdata.txt deliveries.txt" << endl;
+        cout << "       " << argv[0] << " --serve mapdata.txt [socket]   (requests on stdin without a socket, see PlanServer.h)" << endl;
+        cout << "       " << argv[0] << " --batch mapdata.txt deliveries-directory|manifest.txt output-directory" << endl;
         return 1;
     }
 
     StreetMap sm;
-
-    if (!sm.load(argv[1]))
+    if (!loadMap(argv[1], sm))
     {
         cout << "Unable to load map data file " << argv[1] << endl;
         return 1;
     }
 
+    DeliveryPlanner dp(&sm);
+    double totalMiles;
+    string outcome;
+    return planDeliveries(dp, argv[2], cout, totalMiles, outcome) ? 0 : 1;
+}
+
+bool planDeliveries(const DeliveryPlanner& dp, string deliveriesFile, ostream& out, double& totalMiles, string& outcome)
+{
+    //writes everything a single run prints after loading the map, so batch outputs match single runs byte for byte
+    totalMiles = 0;
     GeoCoord depot;
     vector<DeliveryRequest> deliveries;
-    if (!loadDeliveryRequests(argv[2], depot, deliveries))
+    if (!loadDeliveryRequests(deliveriesFile, depot, deliveries, out))
     {
-        cout << "Unable to load delivery request file " << argv[2] << endl;
-        return 1;
+        out << "Unable to load delivery request file " << deliveriesFile << endl;
+        outcome = "UNREADABLE";
+        return false;
     }
 
-    cout << "Generating route...\n\n";
+    out << "Generating route...\n\n";
 
-    DeliveryPlanner dp(&sm);
     vector<DeliveryCommand> dcs;
-    double totalMiles;
     DeliveryResult result = dp.generateDeliveryPlan(depot, deliveries, dcs, totalMiles);
     if (result == BAD_COORD)
     {
-        cout << "One or more depot or delivery coordinates are invalid." << endl;
-        return 1;
+        out << "One or more depot or delivery coordinates are invalid." << endl;
+        outcome = "BAD_COORD";
+        return false;
     }
     if (result == NO_ROUTE)
     {
-        cout << "No route can be found to deliver all items." << endl;
-        return 1;
+        out << "No route can be found to deliver all items." << endl;
+        outcome = "NO_ROUTE";
+        return false;
     }
-    cout << "Starting at the depot...\n";
+    out << "Starting at the depot...\n";
     for (const auto& dc : dcs)
-        cout << dc.description() << endl;
-    cout << "You are back at the depot and your deliveries are done!\n";
+        out << dc.description() << endl;
+    out << "You are back at the depot and your deliveries are done!\n";
+    out.setf(ios::fixed);
+    out.precision(2);
+    out << totalMiles << " miles travelled for all deliveries." << endl;
+    outcome = "OK";
+    return true;
+}
+
+bool loadMap(string mapFile, StreetMap& sm)
+{
+    //maps built by tools/CompileMap.cpp end in .bin, anything else is text
+    bool isBinary = mapFile.size() > 4 && mapFile.compare(mapFile.size() - 4, 4, ".bin") == 0;
+    return isBinary ? sm.loadBinary(mapFile) : sm.load(mapFile);
+}
+
+int serve(string mapFile, string socketPath)
+{
+    //stdout may be carrying answers, so everything else goes to stderr
+    StreetMap sm;
+    if (!loadMap(mapFile, sm))
+    {
+        cerr << "Unable to load map data file " << mapFile << endl;
+        return 1;
+    }
+    PlanServer server(&sm);
+    if (socketPath.empty())
+    {
+        server.serveStream(0, 1);
+        return 0;
+    }
+    cerr << "Serving delivery plans on " << socketPath << endl;
+    if (!server.serveSocket(socketPath))
+    {
+        cerr << "Unable to listen on socket " << socketPath << endl;
+        return 1;
+    }
+    return 0;
+}
+
+int runBatch(string mapFile, string deliveriesSource, string outputDirectory)
+{
+    //the files to plan: every regular file in a directory, in name order, or the paths a manifest lists one to a
+    //line (blank lines and # comments skipped), relative to the manifest's own directory
+    namespace fs = std::filesystem;
+    vector<string> files;
+    error_code error;
+    if (fs::is_directory(deliveriesSource, error))
+    {
+        for (const fs::directory_entry& entry : fs::directory_iterator(deliveriesSource, error))
+        {
+            if (entry.is_regular_file(error))
+                files.push_back(entry.path().string());
+        }
+        sort(files.begin(), files.end());
+    }
+    else
+    {
+        ifstream manifest(deliveriesSource);
+        if (!manifest)
+        {
+            cout << "Unable to read deliveries directory or manifest " << deliveriesSource << endl;
+            return 1;
+        }
+        fs::path base = fs::path(deliveriesSource).parent_path();
+        string line;
+        while (getline(manifest, line))
+        {
+            size_t first = line.find_first_not_of(" \t");
+            if (first == string::npos || line[first] == '#')
+                continue;
+            fs::path path(line.substr(first, line.find_last_not_of(" \t\r") + 1 - first));
+            files.push_back((path.is_relative() ? base / path : path).string());
+        }
+    }
+
+    fs::create_directories(outputDirectory, error);
+    if (!fs::is_directory(outputDirectory, error))
+    {
+        cout << "Unable to create output directory " << outputDirectory << endl;
+        return 1;
+    }
+
+    //each file's output is <name>.out, as a single run would have printed it; a name seen before also gets its
+    //position in the list, so files from different directories can't overwrite each other
+    vector<string> outputs(files.size());
+    vector<string> names(files.size());
+    for (size_t i = 0; i != files.size(); i++)
+        names[i] = fs::path(files[i]).filename().string();
+    vector<string> sortedNames = names;
+    sort(sortedNames.begin(), sortedNames.end());
+    for (size_t i = 0; i != files.size(); i++)
+    {
+        bool repeated = upper_bound(sortedNames.begin(), sortedNames.end(), names[i])
+                      - lower_bound(sortedNames.begin(), sortedNames.end(), names[i]) > 1;
+        string name = repeated ? names[i] + "-" + to_string(i + 1) : names[i];
+        outputs[i] = (fs::path(outputDirectory) / (name + ".out")).string();
+    }
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    StreetMap sm;
+    if (!loadMap(mapFile, sm))
+    {
+        cout << "Unable to load map data file " << mapFile << endl;
+        return 1;
+    }
+    double loadSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    //one plan per file across the shared pool; each plan's own parallel work then mostly runs on its caller's thread
+    DeliveryPlanner dp(&sm);
+    vector<double> miles(files.size(), 0);
+    vector<double> seconds(files.size(), 0);
+    vector<string> outcomes(files.size());
+    start = chrono::steady_clock::now();
+    ThreadPool::shared().parallelFor(files.size(), [&](size_t i) {
+        chrono::steady_clock::time_point planStart = chrono::steady_clock::now();
+        ostringstream out;
+        try
+        {
+            planDeliveries(dp, files[i], out, miles[i], outcomes[i]);
+        }
+        catch (const exception& e)   //whatever goes wrong with one file is that file's outcome, not the batch's
+        {
+            out << "Unable to plan " << files[i] << ": " << e.what() << endl;
+            outcomes[i] = "ERROR";
+        }
+        seconds[i] = chrono::duration<double>(chrono::steady_clock::now() - planStart).count();
+        ofstream outf(outputs[i]);
+        outf << out.str();
+        if (!outf)
+            outcomes[i] = "UNWRITABLE";
+    });
+    double batchSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    //summary: one tab separated line per file, then totals on stdout
+    string summaryFile = (fs::path(outputDirectory) / "summary.tsv").string();
+    ofstream summary(summaryFile);
+    summary << "file\tresult\tmiles\tms\n";
+    summary.setf(ios::fixed);
+    summary.precision(2);
+    double totalMiles = 0;
+    size_t succeeded = 0;
+    for (size_t i = 0; i != files.size(); i++)
+    {
+        summary << files[i] << '\t' << outcomes[i] << '\t' << miles[i] << '\t' << seconds[i] * 1000 << '\n';
+        if (outcomes[i] == "OK")
+        {
+            totalMiles += miles[i];
+            succeeded++;
+        }
+    }
+    if (!summary)
+        cout << "Unable to write " << summaryFile << endl;
+
+    vector<double> latencies = seconds;
+    sort(latencies.begin(), latencies.end());
     cout.setf(ios::fixed);
     cout.precision(2);
-    cout << totalMiles << " miles travelled for all deliveries." << endl;
+    cout << "Planned " << files.size() << " files in " << batchSeconds << " s (map loaded in " << loadSeconds << " s): "
+         << succeeded << " OK, " << files.size() - succeeded << " failed" << endl;
+    cout << totalMiles << " miles travelled for all successful plans." << endl;
+    if (!latencies.empty())
+    {
+        size_t n = latencies.size();
+        cout << "Plan latency: median " << latencies[n / 2] * 1000 << " ms, 90th percentile " << latencies[min(n - 1, n * 9 / 10)] * 1000
+             << " ms, 99th percentile " << latencies[min(n - 1, n * 99 / 100)] * 1000 << " ms, max " << latencies[n - 1] * 1000 << " ms" << endl;
+    }
+    for (size_t i = 0; i != files.size(); i++)
+    {
+        if (outcomes[i] != "OK")
+            cout << "  " << files[i] << ": " << outcomes[i] << endl;
+    }
+    cout << "Outputs written to " << outputDirectory << ", summary in " << summaryFile << endl;
+    return succeeded == files.size() ? 0 : 1;
 }
 
-bool loadDeliveryRequests(string deliveriesFile, GeoCoord& depot, vector<DeliveryRequest>& v)
+bool loadDeliveryRequests(string deliveriesFile, GeoCoord& depot, vector<DeliveryRequest>& v, ostream& messages)
 {
     ifstream inf(deliveriesFile);
     if (!inf)
@@ -67,36 +261,38 @@ bool loadDeliveryRequests(string deliveriesFile, GeoCoord& depot, vector<Deliver
     string lon;
     inf >> lat >> lon;
     inf.ignore(10000, '\n');
+    if (!isValidCoordinate(lat, lon))   //GeoCoord throws on text that isn't a number, which would end a whole batch
+        return false;
     depot = GeoCoord(lat, lon);
     string line;
     while (getline(inf, line))
     {
         string item;
-        if (parseDelivery(line, lat, lon, item))
+        if (parseDelivery(line, lat, lon, item, messages))
             v.push_back(DeliveryRequest(item, GeoCoord(lat, lon)));
     }
     return true;
 }
 
-bool parseDelivery(string line, string& lat, string& lon, string& item)
+bool parseDelivery(string line, string& lat, string& lon, string& item, ostream& messages)
 {
     const size_t colon = line.find(':');
     if (colon == string::npos)
     {
-        cout << "Missing colon in deliveries file line: " << line << endl;
+        messages << "Missing colon in deliveries file line: " << line << endl;
         return false;
     }
     istringstream iss(line.substr(0, colon));
-    if (!(iss >> lat >> lon))
+    if (!(iss >> lat >> lon) || !isValidCoordinate(lat, lon))
     {
-        cout << "Bad format in deliveries file line: " << line << endl;
+        messages << "Bad format in deliveries file line: " << line << endl;
         return false;
     }
     item = line.substr(colon + 1);
     if (item.empty())
     {
-        cout << "Missing item in deliveries file line: " << line << endl;
+        messages << "Missing item in deliveries file line: " << line << endl;
         return false;
     }
     return true;
-}
\ No newline at end of file
+}
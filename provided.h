@@ -6,6 +6,11 @@
 #include <string>
 #include <vector>
 #include <list>
+#include <utility>
+#include <cstdint>
+#include <cmath>
+#include <charconv>
+#include <system_error>
 
 enum DeliveryResult
 {
@@ -49,18 +54,167 @@ bool operator<(const GeoCoord& lhs, const GeoCoord& rhs)
     return lhs.longitudeText < rhs.longitudeText;
 }
 
+// Exact fixed-point form of a coordinate: latitude and longitude as signed
+// counts of 1e-7 degrees (the precision of the map data) packed into one 64-bit
+// integer, so keys compare and hash as integers instead of strings.  Converting
+// a GeoCoord whose text has at most 7 decimal places to a CoordKey and back
+// reproduces the same numbers, printed with exactly 7 decimal places.
+struct CoordKey
+{
+    CoordKey()
+        : bits(0)
+    {}
+
+    CoordKey(std::int32_t latE7, std::int32_t lonE7)
+        : bits(((std::uint64_t)(std::uint32_t)latE7 << 32) | (std::uint32_t)lonE7)
+    {}
+
+    explicit CoordKey(const GeoCoord& gc)
+        : CoordKey(textToE7(gc.latitudeText, gc.latitude), textToE7(gc.longitudeText, gc.longitude))
+    {}
+
+    std::int32_t latitudeE7() const { return (std::int32_t)(std::uint32_t)(bits >> 32); }
+    std::int32_t longitudeE7() const { return (std::int32_t)(std::uint32_t)bits; }
+    double latitude() const { return latitudeE7() / 1e7; }
+    double longitude() const { return longitudeE7() / 1e7; }
+
+    GeoCoord toGeoCoord() const
+    {
+        GeoCoord gc;
+        gc.latitudeText = e7ToText(latitudeE7());
+        gc.longitudeText = e7ToText(longitudeE7());
+        gc.latitude = latitude();
+        gc.longitude = longitude();
+        return gc;
+    }
+
+    // Parses decimal degrees ("-118.4794734") in [first, last) without
+    // allocating.  Digits past the 7th decimal place are rounded.  Returns
+    // false if the text isn't a plain decimal number within +/-180 degrees.
+    static bool parseE7(const char* first, const char* last, std::int32_t& e7)
+    {
+        bool negative = false;
+        if (first != last && (*first == '-' || *first == '+'))
+            negative = (*first++ == '-');
+        std::int64_t value = 0;
+        int digits = 0;
+        for (; first != last && *first >= '0' && *first <= '9'; first++, digits++)
+        {
+            value = value * 10 + (*first - '0');
+            if (value > 180)
+                return false;
+        }
+        int decimals = 0;
+        if (first != last && *first == '.')
+        {
+            for (first++; first != last && *first >= '0' && *first <= '9'; first++, digits++)
+            {
+                if (decimals < 7)
+                {
+                    value = value * 10 + (*first - '0');
+                    decimals++;
+                }
+                else if (decimals == 7)   // round on the first dropped digit, ignore the rest
+                {
+                    value += (*first >= '5');
+                    decimals++;
+                }
+            }
+        }
+        if (first != last || digits == 0)
+            return false;
+        for (; decimals < 7; decimals++)
+            value *= 10;
+        if (value > 1800000000)
+            return false;
+        e7 = (std::int32_t)(negative ? -value : value);
+        return true;
+    }
+
+    static std::string e7ToText(std::int32_t e7)
+    {
+        char buf[16];
+        char* p = buf + sizeof(buf);
+        std::uint32_t magnitude = e7 < 0 ? 0u - (std::uint32_t)e7 : (std::uint32_t)e7;
+        for (int i = 0; i != 7; i++, magnitude /= 10)
+            *--p = (char)('0' + magnitude % 10);
+        *--p = '.';
+        do
+        {
+            *--p = (char)('0' + magnitude % 10);
+            magnitude /= 10;
+        } while (magnitude != 0);
+        if (e7 < 0)
+            *--p = '-';
+        return std::string(p, buf + sizeof(buf));
+    }
+
+    std::uint64_t bits;
+
+private:
+    static std::int32_t textToE7(const std::string& text, double value)
+    {
+        std::int32_t e7;
+        if (parseE7(text.data(), text.data() + text.size(), e7))
+            return e7;
+        return (std::int32_t)std::llround(value * 1e7);   // e.g. exponent notation
+    }
+};
+
+inline
+bool operator==(const CoordKey& lhs, const CoordKey& rhs)
+{
+    return lhs.bits == rhs.bits;
+}
+
+inline
+bool operator!=(const CoordKey& lhs, const CoordKey& rhs)
+{
+    return lhs.bits != rhs.bits;
+}
+
+// True if lat and lon are decimal degrees a GeoCoord can be made from: finite
+// numbers, the latitude within +/-90 and the longitude within +/-180.  Text
+// from a client or a file should pass this first, since GeoCoord throws on
+// anything std::stod rejects.
+inline
+bool isValidCoordinate(const std::string& lat, const std::string& lon)
+{
+    double degrees[2];
+    const std::string* text[2] = { &lat, &lon };
+    for (int i = 0; i != 2; i++)
+    {
+        const char* first = text[i]->data();
+        const char* last = first + text[i]->size();
+        std::from_chars_result result = std::from_chars(first, last, degrees[i]);
+        if (result.ec != std::errc() || result.ptr != last || !std::isfinite(degrees[i]))
+            return false;
+    }
+    return std::fabs(degrees[0]) <= 90 && std::fabs(degrees[1]) <= 180;
+}
+
+typedef std::uint32_t NodeId;   // dense index of a distinct segment endpoint in a loaded StreetMap
+typedef std::uint32_t EdgeId;   // index of a directed segment in a loaded StreetMap
+typedef std::uint32_t NameId;   // index of a street name in a loaded StreetMap
+
+const NodeId NO_NODE = 0xFFFFFFFF;
+const EdgeId NO_EDGE = 0xFFFFFFFF;
+const NameId NO_NAME = 0xFFFFFFFF;
+
 struct StreetSegment
 {
-    StreetSegment(const GeoCoord& s, const GeoCoord& e, std::string streetName)
-        : start(s), end(e), name(streetName)
+    StreetSegment(const GeoCoord& s, const GeoCoord& e, std::string streetName, NameId id = NO_NAME)
+        : start(s), end(e), name(streetName), nameId(id)
     {}
 
     StreetSegment()
+        : nameId(NO_NAME)
     {}
 
     GeoCoord start;
     GeoCoord end;
     std::string name;
+    NameId nameId;   // the map's interned id for name, so segments of one map compare streets as integers
 };
 
 inline
@@ -69,15 +223,139 @@ bool operator==(const StreetSegment& lhs, const StreetSegment& rhs)
     return lhs.start == rhs.start && lhs.end == rhs.end;
 }
 
+
+// Range of the edges leaving one node of a StreetGraph; iterating it yields
+// EdgeIds and never copies or allocates.
+class EdgeRange
+{
+public:
+    class iterator
+    {
+    public:
+        explicit iterator(EdgeId e) : m_edge(e) {}
+        EdgeId operator*() const { return m_edge; }
+        iterator& operator++() { m_edge++; return *this; }
+        bool operator==(const iterator& other) const { return m_edge == other.m_edge; }
+        bool operator!=(const iterator& other) const { return m_edge != other.m_edge; }
+    private:
+        EdgeId m_edge;
+    };
+
+    EdgeRange()
+        : m_first(0), m_last(0)
+    {}
+
+    EdgeRange(EdgeId first, EdgeId last)
+        : m_first(first), m_last(last)
+    {}
+
+    iterator begin() const { return iterator(m_first); }
+    iterator end() const { return iterator(m_last); }
+    std::size_t size() const { return m_last - m_first; }
+    bool empty() const { return m_first == m_last; }
+
+private:
+    EdgeId m_first;
+    EdgeId m_last;
+};
+
+// Read-only compressed sparse row view of a loaded StreetMap.  Every segment
+// appears twice (once in each direction); the edges leaving node n are
+// firstEdge[n] .. firstEdge[n + 1] - 1.  The pointers stay valid until the
+// next call to StreetMap::load.
+struct StreetGraph
+{
+    StreetGraph()
+        : nodeCount(0), edgeCount(0), nameCount(0), latitudes(nullptr), longitudes(nullptr),
+          firstEdge(nullptr), edgeTargets(nullptr), edgeLengths(nullptr), edgeNames(nullptr),
+          nameOffsets(nullptr), nameChars(nullptr)
+    {}
+
+    EdgeRange edgesFrom(NodeId n) const
+    {
+        return EdgeRange(firstEdge[n], firstEdge[n + 1]);
+    }
+
+    std::string streetName(NameId id) const
+    {
+        return std::string(nameChars + nameOffsets[id], nameOffsets[id + 1] - nameOffsets[id]);
+    }
+
+    std::uint32_t        nodeCount;
+    std::uint32_t        edgeCount;
+    std::uint32_t        nameCount;
+    const double*        latitudes;     // per node, in degrees
+    const double*        longitudes;    // per node, in degrees
+    const EdgeId*        firstEdge;     // nodeCount + 1 entries
+    const NodeId*        edgeTargets;   // per edge
+    const double*        edgeLengths;   // per edge, in miles
+    const NameId*        edgeNames;     // per edge
+    const std::uint32_t* nameOffsets;   // nameCount + 1 entries into nameChars
+    const char*          nameChars;
+};
+
+// Figures from the most recent StreetMap::load
+struct MapLoadStats
+{
+    MapLoadStats()
+        : bytes(0), segments(0), seconds(0)
+    {}
+
+    double megabytesPerSecond() const
+    {
+        return seconds > 0 ? bytes / 1e6 / seconds : 0;
+    }
+
+    std::size_t bytes;      // size of the map file
+    std::size_t segments;   // street segments read
+    double      seconds;    // wall time spent in load
+};
+
 class StreetMapImpl;
 
+// Where an arbitrary coordinate meets the map: the closest point on any street
+// segment, 'fraction' of the way along edge 'edge' from node 'from' to node 'to'.
+struct SnappedPoint
+{
+    SnappedPoint()
+        : from(NO_NODE), to(NO_NODE), edge(NO_EDGE), fraction(0), offMapMiles(0)
+    {}
+
+    NodeId   from;
+    NodeId   to;
+    EdgeId   edge;
+    double   fraction;      // 0 at from, 1 at to
+    GeoCoord point;         // the closest point itself, to 7 decimal places
+    double   offMapMiles;   // from the coordinate to point
+};
+
 class StreetMap
 {
 public:
     StreetMap();
     ~StreetMap();
     bool load(std::string mapFile);
+    // A binary map file holds an already built graph; it is memory-mapped and
+    // used in place, so loading it costs little more than checking its checksum
+    // and that its arrays hold a well-formed graph.
+    bool saveBinary(std::string binaryFile) const;
+    bool loadBinary(std::string binaryFile);
     bool getSegmentsThatStartWith(const GeoCoord& gc, std::vector<StreetSegment>& segs) const;
+    const StreetGraph& graph() const;
+    bool getNodeId(const GeoCoord& gc, NodeId& id) const;
+    bool getNodeId(const CoordKey& key, NodeId& id) const;
+    CoordKey getNodeKey(NodeId id) const;
+    GeoCoord getNodeCoord(NodeId id) const;
+    bool getEdgesThatStartWith(const GeoCoord& gc, NodeId& from, EdgeRange& edges) const;
+    StreetSegment getSegment(NodeId from, EdgeId e) const;
+    // Finds the closest point on the map's segments to any coordinate, using a
+    // grid built by the first call after the map is loaded.  Fails only if the map
+    // has no segments.
+    bool snapToSegment(const GeoCoord& gc, SnappedPoint& snapped) const;
+    MapLoadStats getLoadStats() const;
+    // Changes every time the map is loaded (or a load fails), and is never the same for
+    // two loads of any StreetMap, so results derived from the map can tell they're stale.
+    std::uint64_t generation() const;
     //Prevent a StreetMap object from being copied or assigned.
     StreetMap(const StreetMap&) = delete;
     StreetMap& operator=(const StreetMap&) = delete;
@@ -85,6 +363,167 @@ private:
     StreetMapImpl* m_impl;
 };
 
+// A route kept as the map edges it follows from its start node, 4 bytes a
+// segment, rather than as StreetSegments with their strings; segment(i) builds
+// the i-th StreetSegment only when it's asked for.  A route to or from a point
+// that isn't a map node (see DistanceMatrix) can also start and end with a
+// partial segment, which is stored whole.  Routes are cheap to move, so fill
+// one in place or move it rather than copy it.
+class Route
+{
+public:
+    Route()
+        : m_map(nullptr), m_start(NO_NODE), m_hasLeadIn(false), m_hasLeadOut(false)
+    {}
+
+    // Empties the route and makes it start at node start of sm
+    void reset(const StreetMap* sm, NodeId start)
+    {
+        m_map = sm;
+        m_start = start;
+        m_edges.clear();
+        m_hasLeadIn = m_hasLeadOut = false;
+    }
+
+    void appendEdge(EdgeId e) { m_edges.push_back(e); }
+    void setLeadIn(const StreetSegment& s) { m_leadIn = s; m_hasLeadIn = true; }
+    void setLeadOut(const StreetSegment& s) { m_leadOut = s; m_hasLeadOut = true; }
+
+    const StreetMap* streetMap() const { return m_map; }
+    NodeId startNode() const { return m_start; }
+    std::vector<EdgeId>& edges() { return m_edges; }
+    const std::vector<EdgeId>& edges() const { return m_edges; }
+    std::size_t size() const { return m_edges.size() + m_hasLeadIn + m_hasLeadOut; }
+    bool empty() const { return size() == 0; }
+
+    StreetSegment segment(std::size_t i) const
+    {
+        if (m_hasLeadIn)
+        {
+            if (i == 0)
+                return m_leadIn;
+            i--;
+        }
+        if (i == m_edges.size())
+            return m_leadOut;
+        NodeId from = (i == 0 ? m_start : m_map->graph().edgeTargets[m_edges[i - 1]]);
+        return m_map->getSegment(from, m_edges[i]);
+    }
+
+    // Street of segment i, without building the segment
+    NameId nameId(std::size_t i) const
+    {
+        if (m_hasLeadIn)
+        {
+            if (i == 0)
+                return m_leadIn.nameId;
+            i--;
+        }
+        if (i == m_edges.size())
+            return m_leadOut.nameId;
+        return m_map->graph().edgeNames[m_edges[i]];
+    }
+
+    // For code written against routes as lists of segments
+    void toList(std::list<StreetSegment>& route) const
+    {
+        route.clear();
+        for (std::size_t i = 0; i != size(); i++)
+            route.push_back(segment(i));
+    }
+
+private:
+    const StreetMap*    m_map;
+    NodeId              m_start;
+    std::vector<EdgeId> m_edges;
+    bool                m_hasLeadIn;
+    bool                m_hasLeadOut;
+    StreetSegment       m_leadIn;    // from the route's first point to m_start
+    StreetSegment       m_leadOut;   // from the end of the last edge to the route's last point
+};
+
+// How PointToPointRouter searches for a route.  All find the shortest route;
+// the bidirectional search grows from both ends at once and meets in the
+// middle, which settles fewer nodes on long routes.  The contraction hierarchy
+// search needs a ContractionHierarchy built for the router's map and falls
+// back to the unidirectional search without one.
+enum RouteSearchMode
+{
+    SEARCH_UNIDIRECTIONAL, SEARCH_BIDIRECTIONAL, SEARCH_CONTRACTION_HIERARCHY
+};
+
+// Work done by one route search.  PointToPointRouter fills one per query (all
+// counts stay 0 when the route came from its cache), DistanceMatrix keeps one
+// per point.  += adds searches together, keeping the largest peak frontier.
+struct RouteSearchStats
+{
+    RouteSearchStats()
+        : nodesSettled(0), edgesRelaxed(0), heapPushes(0), peakFrontier(0), allocations(0), seconds(0)
+    {}
+    RouteSearchStats& operator+=(const RouteSearchStats& other)
+    {
+        nodesSettled += other.nodesSettled;
+        edgesRelaxed += other.edgesRelaxed;
+        heapPushes += other.heapPushes;
+        if (other.peakFrontier > peakFrontier)
+            peakFrontier = other.peakFrontier;
+        allocations += other.allocations;
+        seconds += other.seconds;
+        return *this;
+    }
+
+    std::size_t nodesSettled;   // nodes whose shortest distance became final
+    std::size_t edgesRelaxed;   // edges looked along from settled nodes
+    std::size_t heapPushes;     // entries added to the search queue(s)
+    std::size_t peakFrontier;   // most entries queued at once, both halves together
+    std::size_t allocations;    // times a search array or queue had to grow its storage
+    double      seconds;        // wall time
+};
+
+class RouterWorkspace;   // RouterWorkspace.h: reusable search state, one per thread
+class RouteCache;        // RouteCache.h: memory-bounded cache of found routes
+class ContractionHierarchyImpl;
+
+// A StreetMap's graph preprocessed for fast shortest route queries.  Building
+// takes seconds, so a hierarchy is normally built once per map file and saved;
+// load() rejects a file built for any other map.  A hierarchy refers to the
+// StreetMap it was built or loaded for, which must outlive it; once that map is
+// reloaded, matches() is false and the hierarchy must be built or loaded again.
+class ContractionHierarchy
+{
+public:
+    ContractionHierarchy();
+    ~ContractionHierarchy();
+    bool build(const StreetMap* sm);
+    bool save(std::string hierarchyFile) const;
+    bool load(std::string hierarchyFile, const StreetMap* sm);
+    bool matches(const StreetMap* sm) const;   // built for this map as currently loaded (same generation())
+    std::size_t shortcutCount() const;
+    // edges receives the map edges of the shortest route, in order from start
+    bool findRoute(NodeId start, NodeId end, std::vector<EdgeId>& edges, double& distance,
+        RouteSearchStats* stats = nullptr, RouterWorkspace* workspace = nullptr) const;
+    //Prevent a ContractionHierarchy object from being copied or assigned.
+    ContractionHierarchy(const ContractionHierarchy&) = delete;
+    ContractionHierarchy& operator=(const ContractionHierarchy&) = delete;
+private:
+    ContractionHierarchyImpl* m_impl;
+};
+
+// Results of PointToPointRouter::generateRoutes, one entry per requested pair.
+// Unless only distances were asked for, pair i's route is the map edges
+// edges[firstEdge[i]] .. edges[firstEdge[i + 1] - 1], leaving startNodes[i].
+struct RouteBatch
+{
+    std::vector<DeliveryResult> results;
+    std::vector<double>         distances;    // miles, 0 unless results[i] is DELIVERY_SUCCESS
+    std::vector<NodeId>         startNodes;   // NO_NODE for a BAD_COORD pair
+    std::vector<std::uint32_t>  firstEdge;    // pairs + 1 entries
+    std::vector<EdgeId>         edges;
+
+    void getRoute(std::size_t i, const StreetMap& sm, Route& route) const;
+    void getRoute(std::size_t i, const StreetMap& sm, std::list<StreetSegment>& route) const;
+};
+
 class PointToPointRouterImpl;
 
 class PointToPointRouter
@@ -92,11 +531,31 @@ class PointToPointRouter
 public:
     PointToPointRouter(const StreetMap* sm);
     ~PointToPointRouter();
+    DeliveryResult generatePointToPointRoute(
+        const GeoCoord& start,
+        const GeoCoord& end,
+        Route& route,
+        double& totalDistanceTravelled,
+        RouteSearchStats* stats = nullptr,
+        RouterWorkspace* workspace = nullptr) const;   // null: a workspace kept for the calling thread
+    // Same, with the route built out into a list of segments
     DeliveryResult generatePointToPointRoute(
         const GeoCoord& start,
         const GeoCoord& end,
         std::list<StreetSegment>& route,
-        double& totalDistanceTravelled) const;
+        double& totalDistanceTravelled,
+        RouteSearchStats* stats = nullptr,
+        RouterWorkspace* workspace = nullptr) const;
+    // Routes many pairs at once on the shared thread pool.  Pairs with the same start
+    // share one search; other pairs use the contraction hierarchy when that mode is
+    // set, and A* otherwise.
+    void generateRoutes(const std::vector<std::pair<GeoCoord, GeoCoord>>& pairs, RouteBatch& batch,
+        bool distancesOnly = false) const;
+    void setSearchMode(RouteSearchMode mode);
+    void setContractionHierarchy(const ContractionHierarchy* ch);
+    // Answers repeated generatePointToPointRoute calls from the cache (see RouteCache.h)
+    // and adds new routes to it.  Null, the default, turns caching off.
+    void setRouteCache(RouteCache* cache);
     //Prevent a PointToPointRouter object from being copied or assigned.
     PointToPointRouter(const PointToPointRouter&) = delete;
     PointToPointRouter& operator=(const PointToPointRouter&) = delete;
@@ -104,6 +563,35 @@ private:
     PointToPointRouterImpl* m_impl;
 };
 
+class DistanceMatrixImpl;
+
+// Shortest road distances between every pair of a set of points, found with one
+// search per point.  The routes each search found to the other points are kept,
+// so getRoute() produces the route behind any entry without searching again; that
+// costs 8 bytes per edge those routes don't share, not memory in proportion to the map.
+// A point that isn't a map node is snapped onto the closest segment, and its routes
+// start or end at the snapped point partway along that segment.  compute() returns
+// BAD_COORD if a point isn't a valid coordinate (finite, latitude within +/-90,
+// longitude within +/-180) or is more than a mile from every segment.
+class DistanceMatrix
+{
+public:
+    DistanceMatrix(const StreetMap* sm);
+    ~DistanceMatrix();
+    DeliveryResult compute(const std::vector<GeoCoord>& points);
+    std::size_t size() const;
+    double distance(std::size_t from, std::size_t to) const;   // miles, infinity if there is no route
+    DeliveryResult getRoute(std::size_t from, std::size_t to, Route& route, double& totalDistanceTravelled) const;
+    DeliveryResult getRoute(std::size_t from, std::size_t to, std::list<StreetSegment>& route,
+        double& totalDistanceTravelled) const;
+    const RouteSearchStats& searchStats(std::size_t from) const;   // of the search from point 'from'
+    //Prevent a DistanceMatrix object from being copied or assigned.
+    DistanceMatrix(const DistanceMatrix&) = delete;
+    DistanceMatrix& operator=(const DistanceMatrix&) = delete;
+private:
+    DistanceMatrixImpl* m_impl;
+};
+
 struct DeliveryRequest
 {
     DeliveryRequest(std::string it, const GeoCoord& loc)
@@ -125,6 +613,29 @@ public:
         std::vector<DeliveryRequest>& deliveries,
         double& oldCrowDistance,
         double& newCrowDistance) const;
+    // Same, costing the tour by road: roadDistances was computed for the depot followed by
+    // the deliveries in their given order (so the depot is its stop 0), and stopOrder receives
+    // the matrix index of each delivery in the new order.  The order is left alone if some
+    // stop can't be reached.
+    void optimizeDeliveryOrder(
+        std::vector<DeliveryRequest>& deliveries,
+        const DistanceMatrix& roadDistances,
+        std::vector<std::size_t>& stopOrder,
+        double& oldDistance,
+        double& newDistance) const;
+    // Shares the deliveries out among 'drivers' round trips from the depot, at most
+    // ceil(deliveries / drivers) each, keeping the fleet's total road distance short.
+    // roadDistances is for the depot followed by the deliveries; tours[d] receives the
+    // matrix index of each of driver d's deliveries in visiting order, and tourDistances[d]
+    // that round trip's length.  Stops improving the assignment once timeBudget seconds
+    // have passed, so it returns within about that long.
+    void assignDeliveries(
+        const DistanceMatrix& roadDistances,
+        int drivers,
+        double timeBudget,
+        std::vector<std::vector<std::size_t>>& tours,
+        std::vector<double>& tourDistances) const;
+    void setTimeBudget(double seconds);   // longest optimizeDeliveryOrder spends improving the order, 1s by default
     //Prevent a DeliveryOptimizer object from being copied or assigned.
     DeliveryOptimizer(const DeliveryOptimizer&) = delete;
     DeliveryOptimizer& operator=(const DeliveryOptimizer&) = delete;
@@ -206,6 +717,23 @@ private:
     double       m_distance;    // 1.92 (in miles)
 };
 
+// Where a DeliveryPlanner plan's work went.  The road distances come from one
+// search per stop, and each leg of the plan is read back from the search made
+// from the stop it leaves, so legs[i] is that search's stats; in a fleet plan
+// every driver's first leg shares the depot's search.
+struct DeliveryPlanStats
+{
+    DeliveryPlanStats()
+        : matrixSeconds(0), optimizeSeconds(0), directionsSeconds(0)
+    {}
+
+    std::vector<RouteSearchStats> legs;   // in driving order, driver after driver in a fleet plan
+    RouteSearchStats searches;            // all the searches added together
+    double matrixSeconds;                 // wall time finding the road distances
+    double optimizeSeconds;               // ordering the deliveries or sharing them out
+    double directionsSeconds;             // turning the legs into commands
+};
+
 class DeliveryPlannerImpl;
 
 class DeliveryPlanner
@@ -217,7 +745,24 @@ public:
         const GeoCoord& depot,
         const std::vector<DeliveryRequest>& deliveries,
         std::vector<DeliveryCommand>& commands,
-        double& totalDistanceTravelled) const;
+        double& totalDistanceTravelled,
+        DeliveryPlanStats* stats = nullptr) const;
+    // Plans for a fleet of 'drivers' drivers who all start and end at the depot: the
+    // deliveries are shared out, at most ceil(deliveries / drivers) per driver, and commands
+    // and distances get one entry per driver (empty and 0 for a driver with nothing to
+    // deliver).  timeBudget bounds the optimization: computing the road distance matrix
+    // is counted against it but can't be cut short, so optimizing gets whatever the
+    // matrix leaves (possibly nothing), and writing the directions comes after it.  The
+    // call takes about max(timeBudget, matrix time) plus the directions.
+    DeliveryResult generateFleetPlan(
+        const GeoCoord& depot,
+        const std::vector<DeliveryRequest>& deliveries,
+        int drivers,
+        double timeBudget,
+        std::vector<std::vector<DeliveryCommand>>& commands,
+        std::vector<double>& distances,
+        double& totalDistanceTravelled,
+        DeliveryPlanStats* stats = nullptr) const;
     //Prevent a DeliveryPlanner object from being copied or assigned.
     DeliveryPlanner(const DeliveryPlanner&) = delete;
     DeliveryPlanner& operator=(const DeliveryPlanner&) = delete;
@@ -251,20 +796,28 @@ inline double rad2deg(double rad) {
 * @param lon2d Longitude of the second point in degrees
 * @return The distance between the two points in kilometers
 */
-inline double distanceEarthKM(const GeoCoord& g1, const GeoCoord& g2) {
+inline double distanceEarthKM(double lat1d, double lon1d, double lat2d, double lon2d) {
     static const double earthRadiusKm = 6371.0;
-    double lat1r = deg2rad(g1.latitude);
-    double lon1r = deg2rad(g1.longitude);
-    double lat2r = deg2rad(g2.latitude);
-    double lon2r = deg2rad(g2.longitude);
+    double lat1r = deg2rad(lat1d);
+    double lon1r = deg2rad(lon1d);
+    double lat2r = deg2rad(lat2d);
+    double lon2r = deg2rad(lon2d);
     double u = std::sin((lat2r - lat1r) / 2);
     double v = std::sin((lon2r - lon1r) / 2);
     return 2.0 * earthRadiusKm * std::asin(std::sqrt(u * u + std::cos(lat1r) * std::cos(lat2r) * v * v));
 }
 
-inline double distanceEarthMiles(const GeoCoord& g1, const GeoCoord& g2) {
+inline double distanceEarthKM(const GeoCoord& g1, const GeoCoord& g2) {
+    return distanceEarthKM(g1.latitude, g1.longitude, g2.latitude, g2.longitude);
+}
+
+inline double distanceEarthMiles(double lat1d, double lon1d, double lat2d, double lon2d) {
     const double milesPerKm = 1 / 1.609344;
-    return distanceEarthKM(g1, g2) * milesPerKm;
+    return distanceEarthKM(lat1d, lon1d, lat2d, lon2d) * milesPerKm;
+}
+
+inline double distanceEarthMiles(const GeoCoord& g1, const GeoCoord& g2) {
+    return distanceEarthMiles(g1.latitude, g1.longitude, g2.latitude, g2.longitude);
 }
 
 inline double angleBetween2Lines(const StreetSegment& line1, const StreetSegment& line2)
@@ -0,0 +1,60 @@
+// BuildHierarchy.cpp
+
+// Builds the contraction hierarchy for a map file and saves it, so programs can
+// load it with ContractionHierarchy::load instead of building it at startup.
+// Rerun it whenever the map changes; a hierarchy file only loads for the map it
+// was built from.
+//
+// Built by CMake as the buildhierarchy target; from the repository root:
+//   cmake -S . -B build && cmake --build build --target buildhierarchy
+//   ./build/buildhierarchy mapdata.txt mapdata.ch
+
+#include "provided.h"
+#include <chrono>
+#include <iostream>
+#include <string>
+using namespace std;
+
+int main(int argc, char* argv[])
+{
+    if (argc != 3)
+    {
+        cout << "Usage: " << argv[0] << " mapdata.txt|mapdata.bin mapdata.ch" << endl;
+        return 1;
+    }
+
+    StreetMap sm;
+    string mapFile = argv[1];
+    bool binary = mapFile.size() > 4 && mapFile.compare(mapFile.size() - 4, 4, ".bin") == 0;
+    if (!(binary ? sm.loadBinary(mapFile) : sm.load(mapFile)))
+    {
+        cout << "Unable to load map data file " << mapFile << endl;
+        return 1;
+    }
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    ContractionHierarchy ch;
+    ch.build(&sm);
+    double buildSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (!ch.save(argv[2]))
+    {
+        cout << "Unable to write hierarchy file " << argv[2] << endl;
+        return 1;
+    }
+
+    //load the result back, both to check it and to show what it saves
+    start = chrono::steady_clock::now();
+    ContractionHierarchy check;
+    if (!check.load(argv[2], &sm) || check.shortcutCount() != ch.shortcutCount())
+    {
+        cout << "Hierarchy file " << argv[2] << " did not load back correctly" << endl;
+        return 1;
+    }
+    double loadSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout.setf(ios::fixed);
+    cout.precision(2);
+    cout << "Wrote " << argv[2] << ": " << sm.graph().nodeCount << " nodes, " << ch.shortcutCount() << " shortcuts" << endl;
+    cout << "Build " << buildSeconds << " s, load " << loadSeconds * 1000 << " ms" << endl;
+    return 0;
+}
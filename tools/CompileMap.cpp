@@ -0,0 +1,53 @@
+// CompileMap.cpp
+
+// Converts a text map file (the mapdata.txt format) into a binary map file that
+// StreetMap::loadBinary can map and use without parsing.  Rerun it whenever the
+// text map changes.
+//
+// Built by CMake as the compilemap target; from the repository root:
+//   cmake -S . -B build && cmake --build build --target compilemap
+//   ./build/compilemap mapdata.txt mapdata.bin
+
+#include "provided.h"
+#include <iostream>
+using namespace std;
+
+int main(int argc, char* argv[])
+{
+    if (argc != 3)
+    {
+        cout << "Usage: " << argv[0] << " mapdata.txt mapdata.bin" << endl;
+        return 1;
+    }
+
+    StreetMap sm;
+    if (!sm.load(argv[1]))
+    {
+        cout << "Unable to load map data file " << argv[1] << endl;
+        return 1;
+    }
+    MapLoadStats textStats = sm.getLoadStats();
+
+    if (!sm.saveBinary(argv[2]))
+    {
+        cout << "Unable to write binary map file " << argv[2] << endl;
+        return 1;
+    }
+
+    //load the result back, both to check it and to show what it saves
+    StreetMap check;
+    if (!check.loadBinary(argv[2]) || check.graph().edgeCount != sm.graph().edgeCount)
+    {
+        cout << "Binary map file " << argv[2] << " did not load back correctly" << endl;
+        return 1;
+    }
+    MapLoadStats binaryStats = check.getLoadStats();
+
+    cout.setf(ios::fixed);
+    cout.precision(2);
+    cout << "Wrote " << argv[2] << ": " << sm.graph().nodeCount << " nodes, " << textStats.segments << " segments, "
+         << sm.graph().nameCount << " street names" << endl;
+    cout << "Text load " << textStats.seconds * 1000 << " ms (" << textStats.megabytesPerSecond() << " MB/s), binary load "
+         << binaryStats.seconds * 1000 << " ms (" << binaryStats.megabytesPerSecond() << " MB/s)" << endl;
+    return 0;
+}
@@ -0,0 +1,389 @@
+// GenerateMap.cpp
+
+// Writes a synthetic street map in the mapdata.txt format, and optionally
+// delivery files for it, for testing and benchmarking at sizes well beyond the
+// Westwood map (~10k segments).  The map is a grid of rows x cols intersections
+// with jittered positions: every eighth row and column is a boulevard, the other
+// streets lose a few blocks at random, and some blocks bend through an extra
+// node partway along, the way curved streets do in the real data.  Each
+// delivery file gets a depot and stops at intersections all reachable from it.
+//
+// The output depends only on the arguments, so a seed names a map: the random
+// numbers come straight from mt19937_64, whose sequence the standard fixes,
+// rather than from the library's distributions, which may differ between
+// compilers.
+//
+// Segments come to about 2.1 x rows x cols:
+//   70 x 70        ~10k segments, Westwood's size
+//   700 x 700      ~1M
+//   2200 x 2200    ~10M, about 450 MB of text
+//
+// Built by CMake as the generatemap target; from the repository root:
+//   cmake -S . -B build && cmake --build build --target generatemap
+//   ./build/generatemap [--seed S] [--stops N] [--radius BLOCKS] rows cols map.txt [deliveries.txt ...]
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+using namespace std;
+
+namespace
+{
+    const int64_t ORIGIN_LAT = 340000000;      //south west corner, E7 degrees: just south of Westwood
+    const int64_t ORIGIN_LON = -1185000000;
+    const int64_t BLOCK_LAT = 10000;           //0.001 degrees, about 110 m
+    const int64_t BLOCK_LON = 12000;           //about the same distance east-west at this latitude
+    const double JITTER = 0.15;                //intersections move up to this fraction of a block
+    const double BEND = 0.1;                   //bend nodes sit up to this fraction of a block off the straight line
+    const double DROPPED_BLOCKS = 0.05;        //of the blocks on ordinary streets
+    const double BENT_BLOCKS = 0.1;
+    const int BOULEVARD_EVERY = 8;
+
+    const char* const ITEMS[] = { "Chicken tenders", "B-Plate salmon", "Beer", "Sushi", "Pad thai", "Burrito",
+                                  "Pizza", "Ramen", "Falafel wrap", "Boba tea", "Pho", "Salad" };
+
+    // Uniform in [0, 1) from the top 53 bits, the same on every platform
+    double uniform(mt19937_64& rng)
+    {
+        return (rng() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    // An offset of up to +-fraction of a block, in E7 degrees
+    int64_t jitter(mt19937_64& rng, int64_t block, double fraction)
+    {
+        return (int64_t)llround((2 * uniform(rng) - 1) * fraction * block);
+    }
+
+    string ordinal(int n)
+    {
+        const char* suffix = "th";
+        if (n % 100 < 11 || n % 100 > 13)
+        {
+            if (n % 10 == 1)
+                suffix = "st";
+            else if (n % 10 == 2)
+                suffix = "nd";
+            else if (n % 10 == 3)
+                suffix = "rd";
+        }
+        return to_string(n) + suffix;
+    }
+
+    // E7 degrees as the map files write them, e.g. 34.0547000
+    void appendDegrees(string& out, int64_t e7)
+    {
+        if (e7 < 0)
+        {
+            out += '-';
+            e7 = -e7;
+        }
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%lld.%07lld", (long long)(e7 / 10000000), (long long)(e7 % 10000000));
+        out += buf;
+    }
+
+    class GridMap
+    {
+    public:
+        GridMap(int rows, int cols, uint64_t seed);
+        bool writeMap(const string& file, size_t& segments) const;
+        bool writeDeliveries(const string& file, uint64_t seed, int stops, int radius) const;
+
+    private:
+        struct Block   //the segment from an intersection to its neighbour east or north
+        {
+            bool present;
+            bool bent;
+            int64_t bendLat;
+            int64_t bendLon;
+        };
+
+        size_t node(int row, int col) const { return (size_t)row * m_cols + col; }
+        bool isBoulevard(int line) const { return line % BOULEVARD_EVERY == 0; }
+        void makeBlock(Block& b, size_t from, size_t to, mt19937_64& rng, bool boulevard);
+        void appendSegment(string& out, int64_t lat1, int64_t lon1, int64_t lat2, int64_t lon2) const;
+        void appendBlock(string& out, const Block& b, size_t from, size_t to, size_t& segments) const;
+        bool writeStreet(FILE* f, string& out, const string& name, const vector<const Block*>& blocks,
+                         const vector<size_t>& nodes, size_t& segments) const;
+        size_t findRoot(size_t n) const;
+        void join(size_t a, size_t b);
+
+        int m_rows;
+        int m_cols;
+        vector<int64_t> m_lat;   //per intersection, E7 degrees
+        vector<int64_t> m_lon;
+        vector<Block> m_east;    //block from (row, col) to (row, col + 1); the last column's are never present
+        vector<Block> m_north;   //block from (row, col) to (row + 1, col); the last row's are never present
+        mutable vector<uint32_t> m_parent;   //union-find over intersections joined by present blocks
+    };
+
+    GridMap::GridMap(int rows, int cols, uint64_t seed)
+        :m_rows(rows), m_cols(cols)
+    {
+        mt19937_64 rng(seed);
+        size_t count = (size_t)rows * cols;
+        m_lat.resize(count);
+        m_lon.resize(count);
+        for (int row = 0; row != rows; row++)
+        {
+            for (int col = 0; col != cols; col++)
+            {
+                m_lat[node(row, col)] = ORIGIN_LAT + row * BLOCK_LAT + jitter(rng, BLOCK_LAT, JITTER);
+                m_lon[node(row, col)] = ORIGIN_LON + col * BLOCK_LON + jitter(rng, BLOCK_LON, JITTER);
+            }
+        }
+
+        m_parent.resize(count);
+        for (size_t n = 0; n != count; n++)
+            m_parent[n] = (uint32_t)n;
+        Block none = { false, false, 0, 0 };
+        m_east.assign(count, none);
+        m_north.assign(count, none);
+        for (int row = 0; row != rows; row++)
+        {
+            for (int col = 0; col + 1 < cols; col++)
+                makeBlock(m_east[node(row, col)], node(row, col), node(row, col + 1), rng, isBoulevard(row));
+        }
+        for (int col = 0; col != cols; col++)
+        {
+            for (int row = 0; row + 1 < rows; row++)
+                makeBlock(m_north[node(row, col)], node(row, col), node(row + 1, col), rng, isBoulevard(col));
+        }
+    }
+
+    void GridMap::makeBlock(Block& b, size_t from, size_t to, mt19937_64& rng, bool boulevard)
+    {
+        //draw every number whether it's used or not, so one block's fate doesn't shift the ones after it
+        double drop = uniform(rng);
+        double bend = uniform(rng);
+        int64_t offsetLat = jitter(rng, BLOCK_LAT, BEND);
+        int64_t offsetLon = jitter(rng, BLOCK_LON, BEND);
+        b.present = boulevard || drop >= DROPPED_BLOCKS;
+        b.bent = b.present && bend < BENT_BLOCKS;
+        b.bendLat = (m_lat[from] + m_lat[to]) / 2 + offsetLat;
+        b.bendLon = (m_lon[from] + m_lon[to]) / 2 + offsetLon;
+        if (b.present)
+            join(from, to);
+    }
+
+    size_t GridMap::findRoot(size_t n) const
+    {
+        while (m_parent[n] != n)
+        {
+            m_parent[n] = m_parent[m_parent[n]];   //path halving
+            n = m_parent[n];
+        }
+        return n;
+    }
+
+    void GridMap::join(size_t a, size_t b)
+    {
+        size_t ra = findRoot(a);
+        size_t rb = findRoot(b);
+        if (ra != rb)
+            m_parent[max(ra, rb)] = (uint32_t)min(ra, rb);
+    }
+
+    void GridMap::appendSegment(string& out, int64_t lat1, int64_t lon1, int64_t lat2, int64_t lon2) const
+    {
+        appendDegrees(out, lat1);
+        out += ' ';
+        appendDegrees(out, lon1);
+        out += ' ';
+        appendDegrees(out, lat2);
+        out += ' ';
+        appendDegrees(out, lon2);
+        out += '\n';
+    }
+
+    void GridMap::appendBlock(string& out, const Block& b, size_t from, size_t to, size_t& segments) const
+    {
+        if (!b.bent)
+        {
+            appendSegment(out, m_lat[from], m_lon[from], m_lat[to], m_lon[to]);
+            segments++;
+            return;
+        }
+        appendSegment(out, m_lat[from], m_lon[from], b.bendLat, b.bendLon);
+        appendSegment(out, b.bendLat, b.bendLon, m_lat[to], m_lon[to]);
+        segments += 2;
+    }
+
+    bool GridMap::writeStreet(FILE* f, string& out, const string& name, const vector<const Block*>& blocks,
+                              const vector<size_t>& nodes, size_t& segments) const
+    {
+        //one mapdata.txt street per unbroken run of blocks, as the real data splits a street wherever it has a gap
+        size_t first = 0;
+        while (first != blocks.size())
+        {
+            if (!blocks[first]->present)
+            {
+                first++;
+                continue;
+            }
+            size_t last = first;
+            size_t count = 0;
+            while (last != blocks.size() && blocks[last]->present)
+            {
+                count += (blocks[last]->bent ? 2 : 1);
+                last++;
+            }
+            out += name;
+            out += '\n';
+            out += to_string(count);
+            out += '\n';
+            for (size_t i = first; i != last; i++)
+                appendBlock(out, *blocks[i], nodes[i], nodes[i + 1], segments);
+            first = last;
+        }
+        if (out.size() > (1 << 20))   //flush in large pieces
+        {
+            if (fwrite(out.data(), 1, out.size(), f) != out.size())
+                return false;
+            out.clear();
+        }
+        return true;
+    }
+
+    bool GridMap::writeMap(const string& file, size_t& segments) const
+    {
+        FILE* f = fopen(file.c_str(), "wb");
+        if (f == nullptr)
+            return false;
+        segments = 0;
+        string out;
+        bool ok = true;
+        vector<const Block*> blocks;
+        vector<size_t> nodes;
+        for (int row = 0; row != m_rows && ok; row++)
+        {
+            blocks.clear();
+            nodes.clear();
+            for (int col = 0; col + 1 < m_cols; col++)
+            {
+                blocks.push_back(&m_east[node(row, col)]);
+                nodes.push_back(node(row, col));
+            }
+            nodes.push_back(node(row, m_cols - 1));
+            string name = ordinal(row + 1) + (isBoulevard(row) ? " Boulevard" : " Street");
+            ok = writeStreet(f, out, name, blocks, nodes, segments);
+        }
+        for (int col = 0; col != m_cols && ok; col++)
+        {
+            blocks.clear();
+            nodes.clear();
+            for (int row = 0; row + 1 < m_rows; row++)
+            {
+                blocks.push_back(&m_north[node(row, col)]);
+                nodes.push_back(node(row, col));
+            }
+            nodes.push_back(node(m_rows - 1, col));
+            string name = ordinal(col + 1) + (isBoulevard(col) ? " Parkway" : " Avenue");
+            ok = writeStreet(f, out, name, blocks, nodes, segments);
+        }
+        if (ok && fwrite(out.data(), 1, out.size(), f) != out.size())
+            ok = false;
+        return fclose(f) == 0 && ok;
+    }
+
+    bool GridMap::writeDeliveries(const string& file, uint64_t seed, int stops, int radius) const
+    {
+        //the depot is on the boulevards, which no gap ever cuts off; stops are drawn until they're connected to it
+        mt19937_64 rng(seed);
+        int boulevards = (m_rows - 1) / BOULEVARD_EVERY + 1;
+        int depotRow = (int)(rng() % boulevards) * BOULEVARD_EVERY;
+        int depotCol = (int)(rng() % m_cols);
+        size_t depot = node(depotRow, depotCol);
+        size_t depotRoot = findRoot(depot);
+
+        int rowLow = 0, rowHigh = m_rows - 1, colLow = 0, colHigh = m_cols - 1;
+        if (radius > 0)
+        {
+            rowLow = max(0, depotRow - radius);
+            rowHigh = min(m_rows - 1, depotRow + radius);
+            colLow = max(0, depotCol - radius);
+            colHigh = min(m_cols - 1, depotCol + radius);
+        }
+
+        string out;
+        appendDegrees(out, m_lat[depot]);
+        out += ' ';
+        appendDegrees(out, m_lon[depot]);
+        out += '\n';
+        for (int i = 0; i != stops; i++)
+        {
+            size_t stop;
+            do
+            {
+                int row = rowLow + (int)(rng() % (uint64_t)(rowHigh - rowLow + 1));
+                int col = colLow + (int)(rng() % (uint64_t)(colHigh - colLow + 1));
+                stop = node(row, col);
+            } while (findRoot(stop) != depotRoot);
+            appendDegrees(out, m_lat[stop]);
+            out += ' ';
+            appendDegrees(out, m_lon[stop]);
+            out += ':';
+            out += ITEMS[i % (sizeof(ITEMS) / sizeof(ITEMS[0]))];
+            out += '\n';
+        }
+
+        FILE* f = fopen(file.c_str(), "wb");
+        if (f == nullptr)
+            return false;
+        bool ok = fwrite(out.data(), 1, out.size(), f) == out.size();
+        return fclose(f) == 0 && ok;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    uint64_t seed = 1;
+    int stops = 20;
+    int radius = 0;   //blocks around the depot the stops are drawn from, 0 for the whole map
+    vector<string> args;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--seed" && i + 1 < argc)
+            seed = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--stops" && i + 1 < argc)
+            stops = atoi(argv[++i]);
+        else if (arg == "--radius" && i + 1 < argc)
+            radius = atoi(argv[++i]);
+        else
+            args.push_back(arg);
+    }
+    int rows = (args.size() >= 3 ? atoi(args[0].c_str()) : 0);
+    int cols = (args.size() >= 3 ? atoi(args[1].c_str()) : 0);
+    if (rows < 2 || cols < 2 || stops < 0 || radius < 0 || (size_t)rows * cols > 0xFFFFFFFFu)
+    {
+        cout << "Usage: " << argv[0] << " [--seed S] [--stops N] [--radius BLOCKS] rows cols map.txt [deliveries.txt ...]" << endl;
+        return 1;
+    }
+
+    GridMap grid(rows, cols, seed);
+    size_t segments;
+    if (!grid.writeMap(args[2], segments))
+    {
+        cout << "Unable to write map data file " << args[2] << endl;
+        return 1;
+    }
+    cout << "Wrote " << args[2] << ": " << (size_t)rows * cols << " intersections, " << segments << " segments" << endl;
+
+    for (size_t f = 3; f < args.size(); f++)
+    {
+        //each file draws from its own stream, so adding a file doesn't change the ones before it
+        if (!grid.writeDeliveries(args[f], seed * 1000003 + f, stops, radius))
+        {
+            cout << "Unable to write delivery request file " << args[f] << endl;
+            return 1;
+        }
+        cout << "Wrote " << args[f] << ": " << stops << " deliveries" << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,140 @@
+// PlanClient.cpp
+
+// Sends delivery files to a running plan server (DeliveryNow --serve) and prints
+// its answers as they arrive.  Each file becomes one request whose id is the
+// file's position on the command line; with --repeat N every file is sent N
+// times, as ids like 2.5, which is an easy way to load the server.  Prints how
+// long the whole exchange took to stderr.
+//
+// Built by CMake as the planclient target; from the repository root:
+//   cmake -S . -B build && cmake --build build
+//   ./build/DeliveryNow --serve mapdata.txt /tmp/deliverynow.sock &
+//   ./build/planclient [--repeat N] /tmp/deliverynow.sock deliveries.txt [deliveries.txt ...]
+
+#include <chrono>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+using namespace std;
+
+namespace
+{
+    // A deliveries file (depot line, then "lat lon:item" lines) as the body of a
+    // request line: "<lat> <lon> | <lat> <lon>:<item> | ..."
+    bool readRequest(const string& file, string& request)
+    {
+        ifstream inf(file);
+        if (!inf)
+            return false;
+        string line;
+        if (!getline(inf, line))
+            return false;
+        request = line;
+        while (getline(inf, line))
+        {
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            if (line.find(':') != string::npos)
+                request += " | " + line;
+        }
+        return true;
+    }
+
+    bool sendAll(int fd, const string& text)
+    {
+        size_t sent = 0;
+        while (sent != text.size())
+        {
+            ssize_t n = send(fd, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return false;
+            sent += (size_t)n;
+        }
+        return true;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int repeat = 1;
+    vector<string> args;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--repeat" && i + 1 < argc)
+            repeat = atoi(argv[++i]);
+        else
+            args.push_back(arg);
+    }
+    if (args.size() < 2 || repeat < 1)
+    {
+        cout << "Usage: " << argv[0] << " [--repeat N] server.sock deliveries.txt [deliveries.txt ...]" << endl;
+        return 1;
+    }
+
+    string requests;
+    for (size_t f = 1; f != args.size(); f++)
+    {
+        string body;
+        if (!readRequest(args[f], body))
+        {
+            cerr << "Unable to load delivery request file " << args[f] << endl;
+            return 1;
+        }
+        for (int r = 1; r <= repeat; r++)
+            requests += to_string(f) + (repeat > 1 ? "." + to_string(r) : "") + " " + body + "\n";
+    }
+
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (args[0].size() >= sizeof(address.sun_path))
+    {
+        cerr << "Socket path too long: " << args[0] << endl;
+        return 1;
+    }
+    strcpy(address.sun_path, args[0].c_str());
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (sockaddr*)&address, sizeof(address)) != 0)
+    {
+        cerr << "Unable to connect to " << args[0] << endl;
+        return 1;
+    }
+
+    //send everything, then say so by closing our half; the server closes its half after the last answer.  Sending
+    //runs beside the reading, since the server stops reading while its answers back up
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    bool sent = false;
+    thread sender([&]() { sent = sendAll(fd, requests) && shutdown(fd, SHUT_WR) == 0; });
+    char buffer[65536];
+    for (;;)
+    {
+        ssize_t got = recv(fd, buffer, sizeof(buffer), 0);
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got <= 0)
+            break;
+        cout.write(buffer, got);
+    }
+    cout.flush();
+    sender.join();
+    close(fd);
+    if (!sent)
+    {
+        cerr << "Unable to send requests to " << args[0] << endl;
+        return 1;
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cerr << (args.size() - 1) * repeat << " requests answered in " << seconds * 1000 << " ms" << endl;
+    return 0;
+}